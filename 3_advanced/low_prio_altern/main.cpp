@@ -37,10 +37,6 @@ public:
     return *this;
   }
 
-  virtual ~StackheapPtr()
-  {
-  }
-
   void delete1()
   {
     if (is_heap)
@@ -93,6 +89,7 @@ public:
     // d) increment
     /* not used here */
 
+    return *this;
   }
   
   void decrease(const void *copy_assign_rhs, bool del)
@@ -143,6 +140,7 @@ class RefCount : public TData {
 
     There also is a call to decrease(), to a function in the base-class, such that the base-class is
     informed of the same changes, and can perform the same mechanism with its data.
+    (resolved at compile time: no virtual functions, no vptr -- unlike the virt_decrease hook in ../main.cpp)
 
     Constructor takes a pointer (to hold the memory for the counter)
     If a pointer is nullptr, then constructor allocates on heap; else pass in memory from outside [typically from stack].
@@ -183,7 +181,7 @@ public:
     return *this;
   }
   
-  virtual ~RefCount()
+  ~RefCount()
   {
     // a) decrease    and if necessary   b) delete
     decrease_cnt_check_del();
@@ -195,9 +193,6 @@ private:
 
   StackheapPtr<cnt_t> cnt_p;
 
-  virtual void virt_decrease(const void *copy_assign_rhs, bool del)
-  {}
-  
   void decrease_cnt_check_del(const void *copy_assign_rhs = nullptr) {
     bool del = false;
     if (--*cnt_p == 0) {
@@ -260,7 +255,7 @@ public:
 
  private:
   std::ostream& print_info(std::ostream &os) {
-    os << "cnt_p " << get_shared_cnt_ptr() << " \tthis " << this << " \t" << get_data() << " (" << *get_shared_cnt_ptr() << ')';
+    return os << "cnt_p " << get_shared_cnt_ptr() << " \tthis " << this << " \t" << get_data() << " (" << *get_shared_cnt_ptr() << ')';
   }
 };
 
@@ -0,0 +1,375 @@
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+  Allocator backends for the heap mode of StackheapPtr / ControlBlock.
+
+  An allocator (policy) provides
+  .    static void *allocate  (std::size_t size, std::size_t align);
+  .    static void  deallocate(void *p, std::size_t size, std::size_t align);
+
+  NewAlloc    plain ::operator new / delete
+  PoolAlloc   thread-local size-class pool (slabs), falls back to NewAlloc for big or over-aligned sizes
+
+  Independently of the allocator: while an ArenaScope is active on a thread, heap mode allocations
+  of that thread are drawn from its Arena instead (see below).
+ */
+
+struct NewAlloc {
+  static void *allocate(std::size_t size, std::size_t align)
+  {
+    if (align > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+      return ::operator new(size, std::align_val_t{align});
+    return ::operator new(size);
+  }
+
+  static void deallocate(void *p, std::size_t size, std::size_t align)
+  {
+    if (align > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+      ::operator delete(p, size, std::align_val_t{align});
+    else
+      ::operator delete(p, size);
+  }
+};
+
+
+
+class Pool
+/*
+  Thread-local size-class pool: one free list per size class (multiples of granularity),
+  refilled from slabs of slab_size bytes (aligned to slab_size; the slab header names the owning pool).
+
+  A block freed on its owner's thread joins the owner's free list. A block freed on another thread is pushed
+  onto the owner's remote list (lock-free, per size class), which the owner takes over as a whole
+  when its free list runs empty: memory handed from a producer to a consumer thread flows back to the producer.
+  Pools are never destroyed: when a thread exits, its pool (with its free and remote lists) is parked
+  in a global depot, and the next new thread adopts it. Slabs are never given back to the system.
+ */
+{
+public:
+  static constexpr std::size_t granularity = 16;
+  static constexpr std::size_t max_size    = 512;
+  static constexpr std::size_t slab_size   = 64 * 1024;
+  static constexpr std::size_t n_classes   = max_size / granularity;
+
+  static void *allocate(std::size_t size)
+  {
+    const std::size_t c = size_class(size);
+    if (Pool *p = local())
+      return p->pop(c);
+    Pool *p = adopt();   // thread exit, after the thread's pool was parked
+    void *res = p->pop(c);
+    park(p);
+    return res;
+  }
+
+  static void deallocate(void *ptr, std::size_t size)
+  {
+    const std::size_t c = size_class(size);
+    Node *n = static_cast<Node *>(ptr);
+    Pool *owner = slab_of(ptr)->owner;
+    if (owner == local()) {
+      n->next = owner->free_list[c];
+      owner->free_list[c] = n;
+      return;
+    }
+    Node *head = owner->remote[c].load(std::memory_order_relaxed);
+    do {
+      n->next = head;
+    } while (! owner->remote[c].compare_exchange_weak(head, n, std::memory_order_release, std::memory_order_relaxed));
+  }
+
+  static void attach() { local(); }   // binds the thread's pool now (it then outlives thread_locals constructed later)
+
+  static constexpr std::size_t size_class(std::size_t size) { return size ? (size - 1) / granularity : 0; }
+
+private:
+  struct Node { Node *next; };
+
+  struct alignas(granularity) Slab { Pool *owner; };
+
+  struct Depot {
+    std::mutex          mtx;
+    std::vector<Pool *> parked;   // pools of exited threads
+  };
+
+  struct Local {   // trivially destructible: still valid after Handle is destroyed
+    Pool *pool   = nullptr;
+    bool  exited = false;
+  };
+
+  struct Handle {   // parks the thread's pool at thread exit
+    ~Handle()
+    {
+      Local &l = tls();
+      park(l.pool);
+      l.pool   = nullptr;
+      l.exited = true;
+    }
+  };
+
+  Pool() = default;
+
+  static Slab *slab_of(void *p)
+  {
+    return reinterpret_cast<Slab *>(reinterpret_cast<std::uintptr_t>(p) & ~std::uintptr_t{slab_size - 1});
+  }
+
+  static Depot &depot()
+  {
+    static Depot *d = new Depot;   // never destroyed: threads may exit during static destruction
+    return *d;
+  }
+
+  static Local &tls()
+  {
+    thread_local Local l;
+    return l;
+  }
+
+  static Pool *local()   // null at thread exit, once the pool is parked
+  {
+    Local &l = tls();
+    if (l.pool == nullptr && ! l.exited) {
+      l.pool = adopt();
+      thread_local Handle handle;
+      (void)handle;
+    }
+    return l.pool;
+  }
+
+  static Pool *adopt()
+  {
+    Depot &d = depot();
+    {
+      std::lock_guard<std::mutex> lock{d.mtx};
+      if (! d.parked.empty()) {
+        Pool *p = d.parked.back();
+        d.parked.pop_back();
+        return p;
+      }
+    }
+    return new Pool;
+  }
+
+  static void park(Pool *p)
+  {
+    Depot &d = depot();
+    std::lock_guard<std::mutex> lock{d.mtx};
+    d.parked.push_back(p);
+  }
+
+  void *pop(std::size_t c)
+  {
+    Node *n = free_list[c];
+    if (n == nullptr && remote[c].load(std::memory_order_relaxed) != nullptr)
+      n = remote[c].exchange(nullptr, std::memory_order_acquire);   // (take the whole list: no ABA)
+    if (n) {
+      free_list[c] = n->next;
+      return n;
+    }
+    const std::size_t block = (c + 1) * granularity;
+    if (static_cast<std::size_t>(bump_end - bump) < block) {
+      Slab *slab = static_cast<Slab *>(::operator new(slab_size, std::align_val_t{slab_size}));
+      slab->owner = this;
+      bump     = reinterpret_cast<unsigned char *>(slab + 1);
+      bump_end = reinterpret_cast<unsigned char *>(slab) + slab_size;
+    }
+    void *p = bump;
+    bump += block;
+    return p;
+  }
+
+  Node                            *free_list[n_classes] = {};
+  unsigned char                   *bump     = nullptr;
+  unsigned char                   *bump_end = nullptr;
+  alignas(64) std::atomic<Node *>  remote[n_classes] = {};   // written by other threads
+};
+
+
+struct PoolAlloc {
+  static void *allocate(std::size_t size, std::size_t align)
+  {
+    if (size > Pool::max_size || align > Pool::granularity)
+      return NewAlloc::allocate(size, align);
+    return Pool::allocate(size);
+  }
+
+  static void deallocate(void *p, std::size_t size, std::size_t align)
+  {
+    if (size > Pool::max_size || align > Pool::granularity)
+      NewAlloc::deallocate(p, size, align);
+    else
+      Pool::deallocate(p, size);
+  }
+};
+
+
+
+class Arena
+/*
+  Bump allocator for request-scoped lifetimes.
+
+  Memory drawn from an arena is handed out as memory "from the outside" (StackheapPtr will not delete it).
+  Objects that are not trivially destructible register their destructor, and release() destroys
+  them all (in reverse order of construction) and frees all memory at once.
+
+  An arena may start from a buffer passed in from the outside (e.g. on the stack, see MonitorScope):
+  it is used first, and only when it is full are chunks allocated; release() keeps the buffer for reuse.
+
+  Do not release() while instances of values drawn from the arena are still alive.
+ */
+{
+public:
+  explicit Arena(std::size_t chunk_size_ = 16 * 1024)
+    : chunk_size{chunk_size_}
+  {
+  }
+
+  Arena(void *buf, std::size_t size, std::size_t chunk_size_ = 16 * 1024)
+    : chunk_size{chunk_size_},
+      initial{static_cast<unsigned char *>(buf)}, initial_end{static_cast<unsigned char *>(buf) + size},
+      cur{initial}, end{initial_end}
+  {
+  }
+
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  ~Arena()
+  {
+    release();
+  }
+
+  void *allocate(std::size_t size, std::size_t align)
+  {
+    std::size_t space = static_cast<std::size_t>(end - cur);
+    void *p = cur;
+    if (cur == nullptr || std::align(align, size, p, space) == nullptr) {
+      new_chunk(size + align);
+      space = static_cast<std::size_t>(end - cur);
+      p = cur;
+      std::align(align, size, p, space);
+    }
+    cur = static_cast<unsigned char *>(p) + size;
+    return p;
+  }
+
+  template <typename T, typename... Args>
+  T *make(Args&&... args)
+  {
+    T *obj = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    if (! std::is_trivially_destructible<T>::value)
+      on_release([](void *o) { static_cast<T *>(o)->~T(); }, obj);
+    return obj;
+  }
+
+  void on_release(void (*fn)(void *), void *obj)
+  {
+    Dtor *d = new (allocate(sizeof(Dtor), alignof(Dtor))) Dtor{fn, obj, dtors};
+    dtors = d;
+  }
+
+  void release()
+  {
+    for (Dtor *d = dtors; d; d = d->next)
+      d->fn(d->obj);
+    dtors = nullptr;
+    while (Chunk *c = chunks) {
+      chunks = c->next;
+      ::operator delete(c);
+    }
+    cur = initial;
+    end = initial_end;
+  }
+
+  static Arena *&current()
+  {
+    thread_local Arena *arena = nullptr;
+    return arena;
+  }
+
+private:
+  struct Chunk { Chunk *next; };
+  struct Dtor  { void (*fn)(void *); void *obj; Dtor *next; };
+
+  void new_chunk(std::size_t min_size)
+  {
+    const std::size_t n = sizeof(Chunk) + (min_size > chunk_size ? min_size : chunk_size);
+    Chunk *c = static_cast<Chunk *>(::operator new(n));
+    c->next = chunks;
+    chunks  = c;
+    cur = reinterpret_cast<unsigned char *>(c + 1);
+    end = reinterpret_cast<unsigned char *>(c) + n;
+  }
+
+  std::size_t    chunk_size;
+  Chunk         *chunks      = nullptr;
+  Dtor          *dtors       = nullptr;
+  unsigned char *initial     = nullptr;   // buffer from the outside (or none)
+  unsigned char *initial_end = nullptr;
+  unsigned char *cur         = nullptr;
+  unsigned char *end         = nullptr;
+};
+
+
+class ArenaScope
+/*
+  While alive, heap mode allocations (StackheapPtr / ControlBlock) of this thread come from the arena.
+  Scopes nest.
+ */
+{
+public:
+  explicit ArenaScope(Arena &arena)
+    : prev{Arena::current()}
+  {
+    Arena::current() = &arena;
+  }
+
+  ArenaScope(const ArenaScope &) = delete;
+  ArenaScope &operator=(const ArenaScope &) = delete;
+
+  ~ArenaScope()
+  {
+    Arena::current() = prev;
+  }
+
+private:
+  Arena *prev;
+};
+
+
+template <std::size_t N = 4096>
+class MonitorScope
+/*
+  Scoped arena on a buffer of N bytes inside the scope object itself (typically on the stack, e.g. per request):
+  while alive, every instance constructed on this thread (RefCount, BaseWrapper, ...) draws its counter and data
+  from the buffer -- no separate stack variables per counter / value, and no heap allocation,
+  unless the buffer overflows (the arena then continues on the heap, in chunks).
+  The end of the scope releases everything at once: instances must not outlive it.
+ */
+{
+public:
+  MonitorScope() = default;
+  explicit MonitorScope(std::size_t chunk_size) : arena{buf, N, chunk_size} {}
+
+  MonitorScope(const MonitorScope &) = delete;
+  MonitorScope &operator=(const MonitorScope &) = delete;
+
+private:
+  alignas(std::max_align_t) unsigned char buf[N];
+  Arena      arena{buf, N};
+  ArenaScope scope{arena};
+};
+
+#endif
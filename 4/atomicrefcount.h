@@ -0,0 +1,126 @@
+#ifndef ATOMICREFCOUNT_H
+#define ATOMICREFCOUNT_H
+
+#include <atomic>
+#include <new>
+#include <utility>
+
+#include "refcount.h"
+#include "epoch.h"
+
+template <typename T, typename CntPolicy = CntAtomic, typename Alloc = PoolAlloc>
+class AtomicRefCount {
+  /*
+    Atomic shared slot holding one instance of RefCount<T, CntPolicy, Alloc> (e.g. an entry of a lock-free,
+    read-mostly lookup table), which may be loaded / stored / compare-exchanged concurrently by many threads.
+
+    Copying a RefCount that another thread may release at the same time is not safe by itself (the counter
+    may be freed between reading cnt_p and incrementing it). Here, the slot points to a node that holds
+    one instance of the value group; a node that is replaced is retired (see epoch.h), and only freed
+    (dropping its instance) once no reader can still be copying from it.
+
+    load()      a new instance of the current value (lock-free: EpochGuard + increment of the counter)
+    read(f)     f(const T &) on the current value, without touching the counter (for hot lookups)
+    store(r)    replaces the value (one node allocation; the old node is retired)
+    exchange(r) replaces the value and returns the old one
+    compare_exchange(expected, desired)   replaces the value if it is still "the same value" as expected
+    .                                     (same value group), else loads the current value into expected
+
+    The value groups are shared across threads: CntPolicy must be thread safe (CntAtomic, CntDeferred, CntWeak<CntAtomic>).
+   */
+  static_assert(CntPolicy::thread_safe, "AtomicRefCount shares value groups across threads: CntPolicy must be thread safe");
+
+  using ref_t = RefCount<T, CntPolicy, Alloc>;
+public:
+  explicit AtomicRefCount(const ref_t &r = ref_t{})
+    : node{create(r)}
+  {
+  }
+
+  AtomicRefCount(const AtomicRefCount &) = delete;
+  AtomicRefCount &operator=(const AtomicRefCount &) = delete;
+
+  ~AtomicRefCount()   // (no concurrent access left)
+  {
+    destroy(node.load(std::memory_order_relaxed));
+  }
+
+  ref_t load() const
+  {
+    EpochGuard g;
+    return node.load(std::memory_order_acquire)->ref;
+  }
+
+  template <typename F>   // F(const T &)
+  decltype(auto) read(F &&f) const
+  {
+    EpochGuard g;
+    return std::forward<F>(f)(node.load(std::memory_order_acquire)->ref.get_data());
+  }
+
+  void store(const ref_t &r)
+  {
+    retire(node.exchange(create(r), std::memory_order_acq_rel));
+  }
+
+  ref_t exchange(const ref_t &r)
+  {
+    Node *n = create(r);
+    EpochGuard g;
+    Node *old = node.exchange(n, std::memory_order_acq_rel);
+    ref_t res{old->ref};
+    retire(old);
+    return res;
+  }
+
+  bool compare_exchange(ref_t &expected, const ref_t &desired)
+  {
+    Node *n = create(desired);
+    EpochGuard g;
+    Node *cur = node.load(std::memory_order_acquire);
+    for (;;) {
+      if (cur->ref.get_shared_cnt_ptr() != expected.get_shared_cnt_ptr()) {
+        expected = cur->ref;
+        destroy(n);
+        return false;
+      }
+      if (node.compare_exchange_weak(cur, n, std::memory_order_acq_rel, std::memory_order_acquire)) {
+        retire(cur);
+        return true;
+      }
+    }
+  }
+
+private:
+  struct Node {
+    ref_t ref;
+  };
+
+  static Node *create(const ref_t &r)
+  {
+    void *mem = Alloc::allocate(sizeof(Node), alignof(Node));
+    try {
+      return new (mem) Node{r};
+    }
+    catch (...) {
+      Alloc::deallocate(mem, sizeof(Node), alignof(Node));
+      throw;
+    }
+  }
+
+  static void destroy(void *p)
+  {
+    Node *n = static_cast<Node *>(p);
+    n->~Node();
+    Alloc::deallocate(p, sizeof(Node), alignof(Node));
+  }
+
+  static void retire(Node *n)
+  {
+    Epoch::retire(n, &destroy);
+  }
+
+  std::atomic<Node *> node;
+};
+
+#endif
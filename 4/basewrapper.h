@@ -1,49 +1,229 @@
 #ifndef BASEWRAPPER_H
 #define BASEWRAPPER_H
 
+#include <cstddef>
+#include <type_traits>
+
 #include "refcount.h"
+#include "monitor.h"
+
+template <typename CntPolicy = CntPlain, typename Monitor = MonitorDefault>
+class BasicBaseWrapper : private Monitor, public RefCount<Symbol, CntPolicy> {
+  /* Class used for monitoring constructor and destructor behaviour.
+     Also monitor instances "of the same value":      "same value" due to: copy construction, copy assignment.
+
+     The value is the name, interned as a Symbol (see symbol.h): one pointer, shared by all values of the same name,
+     and stored inline in each instance (see inline_value, refcount.h).
+     Derived classes may keep a static Symbol, to skip the (lock-free) interning lookup per construction.
+
+     Moves are monitored as well (#move-constructor, #move-assign); a moved-from instance is null
+     (cnt_p 0, count 0), until it is destroyed or assigned to.
+
+     Events are recorded as binary records into a per-thread lock-free ring (see eventlog.h),
+     and formatted off the hot path by the EventLog drainer thread.
+
+     CntPolicy selects the reference counter (see cntpolicy.h): use CntAtomic, if instances
+     "of the same value" are copied/destroyed from several threads.
+
+     Copy-on-write: detach() makes a shared instance the only one of a new value group (#detach of the old group,
+     then #constructor of the new one), e.g. before a derived class changes its own state.
+
+     Bulk API, for arrays (e.g. N copies of one value): copy_n / destroy_n handle a batch of instances "of the same value"
+     with one counter update and one aggregated record (batch n) instead of one per instance.
 
-class BaseWrapper : public RefCount<std::string> {
-  using ref_t = RefCount<std::string>;
+     Monitor selects the monitoring (see monitor.h): with MonitorOff all monitoring code is compiled away,
+     with MonitorTimed<> lifetimes and constructor / destructor self-times are recorded in histograms per name,
+     with MonitorCounted<> only counters per name and event kind are kept (rates: see CounterReporter).
+     With MonitorOn, only sampled value groups are recorded (runtime rate per name, see sampling.h).
+     Monitor is an (empty) base class, so that a stateless monitor costs no space (EBO),
+     and BasicBaseWrapper has no vptr: sizeof(BaseWrapper) == sizeof(RefCount<Symbol>).
+  */
+  using ref_t = RefCount<Symbol, CntPolicy>;
 public:
-  BaseWrapper(const std::string &name = "") : ref_t(name)
+  using ref_t::get_shared_cnt_ptr;
+  using ref_t::use_count;
+  using ref_t::get_data;
+
+  using typename ref_t::cnt_t;
+
+  // cnt_ptr: counter memory passed in from the outside (nullptr: allocated on the heap), see RefCount;
+  // the name needs no memory of its own (stored inline)
+  BasicBaseWrapper(Symbol name = Symbol{}, cnt_t *cnt_ptr = nullptr)
+    : ref_t(name, nullptr, cnt_ptr)
+  {
+    timed_constructed();
+    log_event(EventKind::constructor);
+  }
+  BasicBaseWrapper(const BasicBaseWrapper &rhs) : ref_t(rhs)
   {
-    std::cerr << "#constructor      ";
-    print_info(std::cerr) << std::endl;
+    timed_constructed();
+    log_event(EventKind::copy_constructor);
   }
-  BaseWrapper(const BaseWrapper &rhs) : ref_t(rhs)
+  BasicBaseWrapper(BasicBaseWrapper &&rhs) noexcept : ref_t(std::move(rhs))
   {
-    std::cerr << "#copy-constructor ";
-    print_info(std::cerr) << std::endl;
+    timed_constructed();
+    log_event(EventKind::move_constructor);
   }
 
-  BaseWrapper &operator=(const BaseWrapper &rhs)
+  BasicBaseWrapper &operator=(const BasicBaseWrapper &rhs)
   {
-    std::cerr << "#operator=        ";
-    print_info(std::cerr);
+    if constexpr (! Monitor::enabled) {
+      count_event(get_shared_cnt_ptr() == rhs.get_shared_cnt_ptr() ? EventKind::assign_same : EventKind::assign);
+      ref_t::operator=(rhs);
+      return *this;
+    }
+
     if (get_shared_cnt_ptr() == rhs.get_shared_cnt_ptr()) {
-      std::cerr << "\t already_holding_same_value" << std::endl;
+      log_event(EventKind::assign_same);
       return *this;
     }
+    count_event(EventKind::assign);
 
+    if (! (sampled() || rhs.sampled())) {   // the pair is recorded, if either group is sampled
+      ref_t::operator=(rhs);
+      return *this;
+    }
+
+    Event ev[2];
+    fill_event(ev[0], EventKind::assign);
+    Monitor::track(&ev[0]);   // the old group, before it may be released
     ref_t::operator=(rhs);
-    std::cerr << "\t ==>  ";
-    print_info(std::cerr) << std::endl;
+    fill_event(ev[1], EventKind::assign_result);
+    Monitor::track(&ev[1]);
+    Monitor::log(ev, 2);
     return *this;
   }
 
-  ~BaseWrapper()
+  BasicBaseWrapper &operator=(BasicBaseWrapper &&rhs) noexcept
   {
-    std::cerr << "#destructor       ";
-    print_info(std::cerr) << std::endl;
+    if (this == &rhs)
+      return *this;   // (as RefCount: nothing moves, nothing is recorded)
+    count_event(EventKind::move_assign);
+    if constexpr (! Monitor::enabled) {
+      ref_t::operator=(std::move(rhs));
+      return *this;
+    }
+
+    if (! (sampled() || rhs.sampled())) {
+      ref_t::operator=(std::move(rhs));
+      return *this;
+    }
+
+    Event ev[2];
+    fill_event(ev[0], EventKind::move_assign);
+    Monitor::track(&ev[0]);   // the old group, before it may be released (the new one does not change)
+    ref_t::operator=(std::move(rhs));
+    fill_event(ev[1], EventKind::assign_result);
+    Monitor::log(ev, 2);
+    return *this;
   }
 
-  
+  ~BasicBaseWrapper()
+  {
+    if constexpr (Monitor::timed)
+      Monitor::destroying(name());
+    log_event(EventKind::destructor);
+  }
+
+  // copy-on-write: if shared, makes this the only instance of a new value group; true if detached
+  bool detach()
+  {
+    if constexpr (Monitor::enabled || Monitor::counted) {
+      // #detach (state of the old group) is recorded only if this does split, but before the old group is released:
+      // its cnt_p may be reused right after
+      if (! ref_t::detach_impl([this] { log_event(EventKind::detach); }))
+        return false;
+      record_event(EventKind::constructor);   // (the new group: recorded, but not counted as a construction)
+      return true;
+    } else {
+      return ref_t::detach();
+    }
+  }
+
+  // copy-on-write write access (hides RefCount's, which would detach unlogged)
+  Symbol &get_mutable()
+  {
+    detach();
+    return ref_t::get_mutable();   // (no longer shared: does not detach again)
+  }
+
+  // Bulk API.  D: BasicBaseWrapper, or a class derived from it that adds no state
+  // constructs n copies of src in the uninitialized storage dst[0..n)   (one record: #copy-constructor, batch n)
+  template <typename D>
+  static void copy_n(const D &src, std::size_t n, D *dst)
+  {
+    static_assert(std::is_base_of<BasicBaseWrapper, D>::value && sizeof(D) == sizeof(BasicBaseWrapper), "D must not add state");
+    ref_t::copy_n_impl(src, n, dst);
+    if (n)
+      dst[0].log_event(EventKind::copy_constructor, n);
+  }
+
+  // destroys p[0..n)   (one record per run of consecutive instances of the same value: #destructor, batch k)
+  template <typename D>
+  static void destroy_n(D *p, std::size_t n)
+  {
+    static_assert(std::is_base_of<BasicBaseWrapper, D>::value && sizeof(D) == sizeof(BasicBaseWrapper), "D must not add state");
+    ref_t::destroy_n_impl(p, n, [](D *first, std::size_t k) { first->log_event(EventKind::destructor, k); });
+  }
+
+protected:
+  friend ref_t;   // (copy_n_impl constructs the copies)
+  using bulk_t = typename ref_t::bulk_t;
+
+  // copy, without counting or logging (used by copy_n; forward it in derived classes, to use the bulk API)
+  BasicBaseWrapper(const BasicBaseWrapper &rhs, bulk_t b) noexcept : ref_t(rhs, b) {}
+
 private:
-  std::ostream& print_info(std::ostream &os) {
-    os << "cnt_p " << get_shared_cnt_ptr() << " \tthis " << this << " \t" << get_data() << " (" << *get_shared_cnt_ptr() << ')';
+  void fill_event(Event &ev, EventKind kind, std::size_t batch = 1) const
+  {
+    ev.timestamp = Event::now();
+    ev.obj       = this;
+    ev.cnt_p     = get_shared_cnt_ptr();
+    ev.count     = use_count();
+    ev.batch     = batch;
+    ev.name      = name();
+    ev.kind      = kind;
+  }
+
+  Symbol name()    const { return get_shared_cnt_ptr() ? get_data() : Symbol{}; }   // moved-from: empty
+  bool   sampled() const { return Monitor::sampled(get_shared_cnt_ptr(), name()); }
+
+  void timed_constructed()
+  {
+    if constexpr (Monitor::timed)
+      Monitor::constructed(name());
+  }
+
+  void count_event(EventKind kind, std::size_t n = 1) const
+  {
+    if constexpr (Monitor::counted)
+      Monitor::count(name(), kind, n);
+  }
+
+  void log_event(EventKind kind, std::size_t batch = 1) const
+  {
+    count_event(kind, batch);
+    record_event(kind, batch);
+  }
+
+  void record_event(EventKind kind, std::size_t batch = 1) const
+  {
+    if constexpr (Monitor::enabled) {
+      if (! sampled())
+        return;
+      Event ev;
+      fill_event(ev, kind, batch);
+      Monitor::record(&ev);
+    }
   }
   
 };
 
+using BaseWrapper = BasicBaseWrapper<>;
+
+static_assert(sizeof(BasicBaseWrapper<CntPlain, MonitorOn>) == sizeof(RefCount<Symbol>)
+              && sizeof(BasicBaseWrapper<CntPlain, MonitorCounted<>>) == sizeof(RefCount<Symbol>),
+              "monitoring must not add per-instance state");
+static_assert(sizeof(BaseWrapper) == 2 * sizeof(void *), "BaseWrapper must be two words: cnt_p and data");
+
 #endif
@@ -0,0 +1,65 @@
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include "../refcount.h"
+
+/*
+  Heap mode allocation backends: ::operator new vs. thread-local size-class pool vs. arena
+  (vs. arena on a stack buffer: MonitorScope).
+ */
+
+template <typename Alloc>
+static void BM_stackheapptr_new_delete(benchmark::State &state)
+{
+  for (auto _ : state) {
+    StackheapPtr<std::size_t, Alloc> p;
+    benchmark::DoNotOptimize(&*p);
+    p.delete1();
+  }
+}
+BENCHMARK_TEMPLATE(BM_stackheapptr_new_delete, NewAlloc);
+BENCHMARK_TEMPLATE(BM_stackheapptr_new_delete, PoolAlloc);
+
+template <typename Alloc>
+static void BM_refcount_ctor_dtor(benchmark::State &state)
+{
+  for (auto _ : state) {
+    RefCount<int, CntPlain, Alloc> r{42};
+    benchmark::DoNotOptimize(&r.get_data());
+  }
+}
+BENCHMARK_TEMPLATE(BM_refcount_ctor_dtor, NewAlloc);
+BENCHMARK_TEMPLATE(BM_refcount_ctor_dtor, PoolAlloc);
+
+static void BM_refcount_ctor_dtor_arena(benchmark::State &state)
+{
+  // one "request" = 1000 values, released at once
+  Arena arena;
+  for (auto _ : state) {
+    {
+      ArenaScope scope{arena};
+      for (int i = 0; i < 1000; ++i) {
+        RefCount<int> r{i};
+        benchmark::DoNotOptimize(&r.get_data());
+      }
+    }
+    arena.release();
+  }
+  state.SetItemsProcessed(state.iterations() * 1000);
+}
+BENCHMARK(BM_refcount_ctor_dtor_arena);
+
+static void BM_refcount_ctor_dtor_monitor_scope(benchmark::State &state)
+{
+  // one "request" = 1000 values, on a stack buffer (no heap allocation), released at the end of the scope
+  for (auto _ : state) {
+    MonitorScope<32 * 1024> scope;
+    for (int i = 0; i < 1000; ++i) {
+      RefCount<int> r{i};
+      benchmark::DoNotOptimize(&r.get_data());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * 1000);
+}
+BENCHMARK(BM_refcount_ctor_dtor_monitor_scope);
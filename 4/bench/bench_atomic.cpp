@@ -0,0 +1,69 @@
+#include <mutex>
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include "../atomicrefcount.h"
+#include "bench_util.h"
+
+/*
+  Read-mostly shared slot (e.g. an entry of a lookup table), with a growing number of reader threads:
+
+  mutex:  RefCount<std::string, CntAtomic> guarded by a std::mutex, copied under the lock
+  load:   AtomicRefCount::load (epoch guard + counter increment)
+  read:   AtomicRefCount::read (epoch guard only: readers share no written cache line)
+  store:  AtomicRefCount::store by one thread, the others load (node allocation + retire)
+ */
+
+using Str = RefCount<std::string, CntAtomic>;
+
+static void BM_slot_mutex_load(benchmark::State &state)
+{
+  static std::mutex mtx;
+  static Str        slot{std::string(32, 'x')};
+  for (auto _ : state) {
+    std::unique_lock<std::mutex> lock{mtx};
+    Str copy{slot};
+    lock.unlock();
+    benchmark::DoNotOptimize(copy.get_data().size());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_slot_atomic_load(benchmark::State &state)
+{
+  static AtomicRefCount<std::string> slot{Str{std::string(32, 'x')}};
+  for (auto _ : state) {
+    Str copy = slot.load();
+    benchmark::DoNotOptimize(copy.get_data().size());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_slot_atomic_read(benchmark::State &state)
+{
+  static AtomicRefCount<std::string> slot{Str{std::string(32, 'x')}};
+  for (auto _ : state)
+    benchmark::DoNotOptimize(slot.read([](const std::string &s) { return s.size(); }));
+  state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_slot_atomic_store(benchmark::State &state)
+{
+  static AtomicRefCount<std::string> slot{Str{std::string(32, 'x')}};
+  const Str value{std::string(32, 'y')};
+  for (auto _ : state) {
+    if (state.thread_index() == 0) {
+      slot.store(value);
+    } else {
+      Str copy = slot.load();
+      benchmark::DoNotOptimize(copy.get_data().size());
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_slot_mutex_load)->ThreadRange(1, max_threads())->UseRealTime();
+BENCHMARK(BM_slot_atomic_load)->ThreadRange(1, max_threads())->UseRealTime();
+BENCHMARK(BM_slot_atomic_read)->ThreadRange(1, max_threads())->UseRealTime();
+BENCHMARK(BM_slot_atomic_store)->ThreadRange(1, max_threads())->UseRealTime();
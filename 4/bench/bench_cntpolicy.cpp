@@ -0,0 +1,77 @@
+#include <benchmark/benchmark.h>
+
+#include "../refcount.h"
+#include "../weakref.h"
+#include "bench_util.h"
+
+/*
+  Copy/destroy throughput of RefCount<T, CntPolicy> for each counter policy,
+  with a growing number of threads.
+
+  shared:  all threads copy/destroy instances "of the same value" (one contended counter)
+  private: each thread has its own value (uncontended counter) -- the cost of the policy itself
+
+  shared, 1..64 threads: scaling of one hot value with CntAtomic vs CntDeferred
+  (CntDeferred: each thread flushes its pending decrements at the end, see DeferredScope)
+
+  weak lock: WeakRef::lock() of a live value (CntWeak: compare-and-swap on the strong count) and destroy
+ */
+
+template <typename CntPolicy>
+static void BM_copy_destroy_shared(benchmark::State &state)
+{
+  DeferredScope deferred;
+  static RefCount<int, CntPolicy> *shared = nullptr;
+  if (state.thread_index() == 0)
+    shared = new RefCount<int, CntPolicy>{42};
+
+  for (auto _ : state) {
+    RefCount<int, CntPolicy> copy{*shared};
+    benchmark::DoNotOptimize(copy.get_data());
+  }
+
+  if (state.thread_index() == 0)
+    delete shared;
+  state.SetItemsProcessed(state.iterations());
+}
+
+template <typename CntPolicy>
+static void BM_copy_destroy_private(benchmark::State &state)
+{
+  DeferredScope deferred;
+  RefCount<int, CntPolicy> own{42};
+  for (auto _ : state) {
+    RefCount<int, CntPolicy> copy{own};
+    benchmark::DoNotOptimize(copy.get_data());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// CntPlain must not be shared across threads
+BENCHMARK_TEMPLATE(BM_copy_destroy_shared,  CntPlain)->Threads(1);
+BENCHMARK_TEMPLATE(BM_copy_destroy_shared,  CntAtomic)->ThreadRange(1, max_threads())->UseRealTime();
+
+BENCHMARK_TEMPLATE(BM_copy_destroy_private, CntPlain)->ThreadRange(1, max_threads())->UseRealTime();
+BENCHMARK_TEMPLATE(BM_copy_destroy_private, CntAtomic)->ThreadRange(1, max_threads())->UseRealTime();
+BENCHMARK_TEMPLATE(BM_copy_destroy_private, CntDeferred)->ThreadRange(1, max_threads())->UseRealTime();
+BENCHMARK_TEMPLATE(BM_copy_destroy_private, CntWeak<CntAtomic>)->ThreadRange(1, max_threads())->UseRealTime();
+
+BENCHMARK_TEMPLATE(BM_copy_destroy_shared,  CntAtomic)->Name("BM_copy_destroy_shared_scaling<CntAtomic>")
+                                                      ->ThreadRange(1, 64)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_copy_destroy_shared,  CntDeferred)->Name("BM_copy_destroy_shared_scaling<CntDeferred>")
+                                                        ->ThreadRange(1, 64)->UseRealTime();
+
+static void BM_weak_lock(benchmark::State &state)
+{
+  static RefCount<int, CntWeak<>> shared{42};
+  WeakRef<int, CntWeak<>> weak{shared};
+
+  for (auto _ : state) {
+    RefCount<int, CntWeak<>> strong = weak.lock();
+    benchmark::DoNotOptimize(strong.get_data());
+  }
+
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_weak_lock)->ThreadRange(1, max_threads())->UseRealTime();
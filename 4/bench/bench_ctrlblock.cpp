@@ -0,0 +1,76 @@
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "../refcount.h"
+#include "bench_util.h"
+
+/*
+  Construction + destruction of a value group:
+  fused ControlBlock (one allocation) vs. the previous layout (counter and data allocated separately).
+ */
+
+static const std::string name{"a_name_that_does_not_fit_into_sso_buffer"};
+
+static void BM_ctor_dtor_two_allocations(benchmark::State &state)
+{
+  for (auto _ : state) {
+    StackheapPtr<std::size_t> cnt_p;
+    StackheapPtr<std::string> data;
+    *cnt_p = 1U;
+    *data  = name;
+    benchmark::DoNotOptimize(&*data);
+    data.delete1();
+    cnt_p.delete1();
+  }
+}
+BENCHMARK(BM_ctor_dtor_two_allocations);
+
+static void BM_ctor_dtor_control_block(benchmark::State &state)
+{
+  for (auto _ : state) {
+    RefCount<std::string> r{name};
+    benchmark::DoNotOptimize(&r.get_data());
+  }
+}
+BENCHMARK(BM_ctor_dtor_control_block);
+
+static void BM_ctor_dtor_stack_storage(benchmark::State &state)
+{
+  for (auto _ : state) {
+    std::string                  dat;
+    RefCount<std::string>::cnt_t cnt;
+    RefCount<std::string> r{name, &dat, &cnt};
+    benchmark::DoNotOptimize(&r.get_data());
+  }
+}
+BENCHMARK(BM_ctor_dtor_stack_storage);
+
+/*
+  get_data() of small values: inline (inline_value<T>) vs behind a pointer, over many value groups
+ */
+struct Boxed { long v; };
+template <> struct inline_value<Boxed> : std::false_type {};
+
+static long value(long v)         { return v; }
+static long value(const Boxed &b) { return b.v; }
+
+template <typename T>
+static void BM_get_data(benchmark::State &state)
+{
+  std::vector<RefCount<T>> groups;
+  for (long i = 0; i < 4096; ++i)
+    groups.emplace_back(T{i});
+  for (auto _ : state) {
+    long sum = 0;
+    for (const auto &r : groups)
+      sum += value(r.get_data());
+    benchmark::DoNotOptimize(sum);
+  }
+  set_objects_processed(state, state.iterations() * static_cast<std::int64_t>(groups.size()));
+}
+BENCHMARK_TEMPLATE(BM_get_data, long);
+BENCHMARK_TEMPLATE(BM_get_data, Boxed);
@@ -0,0 +1,249 @@
+#include <memory>
+#include <new>
+#include <string>
+#include <type_traits>
+
+#include <benchmark/benchmark.h>
+
+#include "../basewrapper.h"
+#include "../refcountonly.h"
+#include "../intrusive.h"
+#include "bench_util.h"
+
+/*
+  Lifecycle hot paths [time per object: counter per_object], for RefCount<std::string>, RefCountOnly, IntrusivePtr
+  (counter inside the object, see intrusive.h) and BaseWrapper (monitoring off / on):
+
+  construct_heap   constructor, counter (and data) allocated on the heap
+  construct_ext    constructor, memory passed in from the outside
+  copy             copy constructor (additional instance "of the same value")
+  assign_self      operator= with rhs already holding the same value (short-circuit)
+  assign_cross     operator= with rhs holding another value
+  destroy          destructor of the last instance (includes freeing the value)
+  copy_n           bulk API: n_batch copies in one step            (not for RefCountOnly, IntrusivePtr)
+  destroy_n        bulk API: destroy n_batch copies in one step    (compare: copy / destroy of copies, per instance)
+
+  Objects are constructed / destroyed in batches of n_batch; the other half of each batch (destruction /
+  construction) is not timed.
+  JSON output (for tracking regressions):   make bench-json   (or: bench --benchmark_format=json)
+ */
+
+using WrapperOff = BasicBaseWrapper<CntPlain, MonitorOff>;
+using WrapperOn  = BasicBaseWrapper<CntPlain, MonitorOn>;
+
+static constexpr int n_batch = 256;
+
+template <typename W>
+struct Lifecycle {   // RefCount<std::string>
+  struct Storage {
+    typename W::data_t   dat;
+    typename W::cnt_t    cnt;
+  };
+
+  static W  make()                            { return W{"name"}; }
+  static W *make_heap(void *mem)              { return new (mem) W{"name"}; }
+  static W *make_ext (void *mem, Storage &s)  { return new (mem) W{"name", &s.dat, &s.cnt}; }
+};
+
+template <typename CntPolicy, typename Monitor>
+struct Lifecycle<BasicBaseWrapper<CntPolicy, Monitor>> {   // the name is stored inline: only the counter from the outside
+  using W = BasicBaseWrapper<CntPolicy, Monitor>;
+  struct Storage {
+    typename W::cnt_t    cnt;
+  };
+
+  static W  make()                            { return W{"name"}; }
+  static W *make_heap(void *mem)              { return new (mem) W{"name"}; }
+  static W *make_ext (void *mem, Storage &s)  { return new (mem) W{"name", &s.cnt}; }
+};
+
+template <typename CntPolicy>
+struct Lifecycle<RefCountOnly<CntPolicy>> {
+  using W = RefCountOnly<CntPolicy>;
+  struct Storage {
+    typename W::cnt_t    cnt;
+  };
+
+  static W  make()                            { return W{}; }
+  static W *make_heap(void *mem)              { return new (mem) W{}; }
+  static W *make_ext (void *mem, Storage &s)  { return new (mem) W{&s.cnt}; }
+};
+
+struct IntrusiveObj : IntrusiveRefCount<IntrusiveObj> {};
+
+template <>
+struct Lifecycle<IntrusivePtr<IntrusiveObj>> {   // construct_ext: the object itself is the memory from the outside
+  using W = IntrusivePtr<IntrusiveObj>;
+  struct Storage {
+    IntrusiveObj obj;
+  };
+
+  static W  make()                            { return W::make(); }
+  static W *make_heap(void *mem)              { return new (mem) W{W::make()}; }
+  static W *make_ext (void *mem, Storage &s)  { return new (mem) W{&s.obj}; }
+};
+
+template <typename W>
+struct Batch {
+  std::aligned_storage_t<sizeof(W), alignof(W)> mem[n_batch];
+  typename Lifecycle<W>::Storage                storage[n_batch];
+
+  W *at(int i) { return std::launder(reinterpret_cast<W *>(&mem[i])); }
+
+  void destroy_all()
+  {
+    for (int i = 0; i < n_batch; ++i)
+      at(i)->~W();
+  }
+};
+
+
+template <typename W>
+static void BM_construct_heap(benchmark::State &state)
+{
+  discard_events();
+  auto b = std::make_unique<Batch<W>>();
+  for (auto _ : state) {
+    for (int i = 0; i < n_batch; ++i)
+      benchmark::DoNotOptimize(Lifecycle<W>::make_heap(&b->mem[i]));
+    state.PauseTiming();
+    b->destroy_all();
+    state.ResumeTiming();
+  }
+  set_objects_processed(state, state.iterations() * n_batch);
+}
+
+template <typename W>
+static void BM_construct_ext(benchmark::State &state)
+{
+  discard_events();
+  auto b = std::make_unique<Batch<W>>();
+  for (auto _ : state) {
+    for (int i = 0; i < n_batch; ++i)
+      benchmark::DoNotOptimize(Lifecycle<W>::make_ext(&b->mem[i], b->storage[i]));
+    state.PauseTiming();
+    b->destroy_all();
+    state.ResumeTiming();
+  }
+  set_objects_processed(state, state.iterations() * n_batch);
+}
+
+template <typename W>
+static void BM_copy(benchmark::State &state)
+{
+  discard_events();
+  auto b = std::make_unique<Batch<W>>();
+  W src = Lifecycle<W>::make();
+  for (auto _ : state) {
+    for (int i = 0; i < n_batch; ++i)
+      benchmark::DoNotOptimize(new (&b->mem[i]) W{src});
+    state.PauseTiming();
+    b->destroy_all();
+    state.ResumeTiming();
+  }
+  set_objects_processed(state, state.iterations() * n_batch);
+}
+
+template <typename W>
+static void BM_assign_self(benchmark::State &state)
+{
+  discard_events();
+  W a = Lifecycle<W>::make();
+  W b{a};
+  for (auto _ : state) {
+    b = a;
+    benchmark::ClobberMemory();
+  }
+  set_objects_processed(state, state.iterations());
+}
+
+template <typename W>
+static void BM_assign_cross(benchmark::State &state)
+{
+  discard_events();
+  W x = Lifecycle<W>::make();
+  W y = Lifecycle<W>::make();
+  W w{x};
+  bool flip = false;
+  for (auto _ : state) {
+    w = flip ? x : y;
+    flip = ! flip;
+    benchmark::ClobberMemory();
+  }
+  set_objects_processed(state, state.iterations());
+}
+
+template <typename W>
+static void BM_destroy(benchmark::State &state)
+{
+  discard_events();
+  auto b = std::make_unique<Batch<W>>();
+  for (auto _ : state) {
+    state.PauseTiming();
+    for (int i = 0; i < n_batch; ++i)
+      Lifecycle<W>::make_heap(&b->mem[i]);
+    state.ResumeTiming();
+    b->destroy_all();
+    benchmark::ClobberMemory();
+  }
+  set_objects_processed(state, state.iterations() * n_batch);
+}
+
+template <typename W>
+static void BM_copy_n(benchmark::State &state)
+{
+  discard_events();
+  auto b = std::make_unique<Batch<W>>();
+  W src = Lifecycle<W>::make();
+  for (auto _ : state) {
+    W::copy_n(src, n_batch, b->at(0));
+    benchmark::ClobberMemory();
+    state.PauseTiming();
+    W::destroy_n(b->at(0), n_batch);
+    state.ResumeTiming();
+  }
+  set_objects_processed(state, state.iterations() * n_batch);
+}
+
+template <typename W>
+static void BM_destroy_n(benchmark::State &state)
+{
+  discard_events();
+  auto b = std::make_unique<Batch<W>>();
+  W src = Lifecycle<W>::make();
+  for (auto _ : state) {
+    state.PauseTiming();
+    W::copy_n(src, n_batch, b->at(0));
+    state.ResumeTiming();
+    W::destroy_n(b->at(0), n_batch);
+    benchmark::ClobberMemory();
+  }
+  set_objects_processed(state, state.iterations() * n_batch);
+}
+
+
+#define LIFECYCLE_BENCHMARKS(W)                \
+  BENCHMARK_TEMPLATE(BM_construct_heap, W);    \
+  BENCHMARK_TEMPLATE(BM_construct_ext,  W);    \
+  BENCHMARK_TEMPLATE(BM_copy,           W);    \
+  BENCHMARK_TEMPLATE(BM_assign_self,    W);    \
+  BENCHMARK_TEMPLATE(BM_assign_cross,   W);    \
+  BENCHMARK_TEMPLATE(BM_destroy,        W)
+
+using RefCountString = RefCount<std::string>;
+using RefCountOnlyPlain = RefCountOnly<>;
+using IntrusiveHandle   = IntrusivePtr<IntrusiveObj>;
+
+LIFECYCLE_BENCHMARKS(RefCountString);
+LIFECYCLE_BENCHMARKS(RefCountOnlyPlain);
+LIFECYCLE_BENCHMARKS(IntrusiveHandle);
+LIFECYCLE_BENCHMARKS(WrapperOff);
+LIFECYCLE_BENCHMARKS(WrapperOn);
+
+#define BULK_BENCHMARKS(W)                     \
+  BENCHMARK_TEMPLATE(BM_copy_n,         W);    \
+  BENCHMARK_TEMPLATE(BM_destroy_n,      W)
+
+BULK_BENCHMARKS(RefCountString);
+BULK_BENCHMARKS(WrapperOff);
+BULK_BENCHMARKS(WrapperOn);
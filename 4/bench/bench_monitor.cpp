@@ -0,0 +1,141 @@
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <benchmark/benchmark.h>
+
+#include "../basewrapper.h"
+#include "bench_util.h"
+
+/*
+  Cost of monitoring: BasicBaseWrapper<CntPlain, MonitorOff> must cost what the bare RefCount costs:
+  the same size (static_assert below), and the same time per ctor/dtor
+  (compare BM_ctor_dtor_unwrapped with BM_ctor_dtor_wrapped<MonitorOff>; the generated code itself is not checked).
+ */
+
+using Unwrapped = RefCount<Symbol>;
+template <typename Monitor>
+using Wrapped   = BasicBaseWrapper<CntPlain, Monitor>;
+
+static_assert(sizeof(Wrapped<MonitorOff>) == sizeof(Unwrapped), "MonitorOff must not add any state");
+
+static void BM_ctor_dtor_unwrapped(benchmark::State &state)
+{
+  for (auto _ : state) {
+    Unwrapped r{"name"};
+    benchmark::DoNotOptimize(&r.get_data());
+  }
+}
+BENCHMARK(BM_ctor_dtor_unwrapped);
+
+template <typename Monitor>
+static void BM_ctor_dtor_wrapped(benchmark::State &state)
+{
+  discard_events();
+  for (auto _ : state) {
+    Wrapped<Monitor> w{"name"};
+    benchmark::DoNotOptimize(&w.get_data());
+  }
+}
+BENCHMARK_TEMPLATE(BM_ctor_dtor_wrapped, MonitorOff);
+BENCHMARK_TEMPLATE(BM_ctor_dtor_wrapped, MonitorOn);
+BENCHMARK_TEMPLATE(BM_ctor_dtor_wrapped, MonitorTimed<MonitorOff>);
+BENCHMARK_TEMPLATE(BM_ctor_dtor_wrapped, MonitorCounted<MonitorOff>);
+
+static void BM_copy_unwrapped(benchmark::State &state)
+{
+  Unwrapped r{"name"};
+  for (auto _ : state) {
+    Unwrapped c{r};
+    benchmark::DoNotOptimize(&c.get_data());
+  }
+}
+BENCHMARK(BM_copy_unwrapped);
+
+template <typename Monitor>
+static void BM_copy_wrapped(benchmark::State &state)
+{
+  discard_events();
+  Wrapped<Monitor> w{"name"};
+  for (auto _ : state) {
+    Wrapped<Monitor> c{w};
+    benchmark::DoNotOptimize(&c.get_data());
+  }
+}
+BENCHMARK_TEMPLATE(BM_copy_wrapped, MonitorOff);
+BENCHMARK_TEMPLATE(BM_copy_wrapped, MonitorOn);
+BENCHMARK_TEMPLATE(BM_copy_wrapped, MonitorCounted<MonitorOff>);
+
+// MonitorOn with sampling: cost of an unsampled group (rate 0) vs a sampled group (rate 1)
+// (other rates would measure one of these: the pool hands out the same block, i.e. the same cnt_p, every iteration)
+static void BM_ctor_dtor_sampled(benchmark::State &state)
+{
+  discard_events();
+  const Symbol name{"sampled"};
+  Sampling::set_rate(name, static_cast<std::uint32_t>(state.range(0)));
+  for (auto _ : state) {
+    Wrapped<MonitorOn> w{name};
+    benchmark::DoNotOptimize(&w.get_data());
+  }
+  Sampling::reset_rate(name);
+}
+BENCHMARK(BM_ctor_dtor_sampled)->Arg(0)->Arg(1);
+
+// MonitorTimed: one histogram update (without reading the clock)
+static void BM_histogram_record(benchmark::State &state)
+{
+  Histograms::Set *s = Histograms::local(Symbol{"histogram"});
+  std::uint64_t v = 1;
+  for (auto _ : state) {
+    s->lifetime.record(v);
+    v = v * 3 + 1;   // spread over the buckets
+  }
+}
+BENCHMARK(BM_histogram_record);
+
+// Text format of a drained batch (1024 events, to /dev/null):
+// TextSink (to_chars into a fixed buffer, one write(2)) vs the same lines with chained operator<< on an ofstream
+static Event text_event(std::size_t i)
+{
+  static const Symbol name{"MyClass"};
+  static int objs[2];
+  return Event{Event::now(), &objs[i % 2], &objs[(i + 1) % 2], i % 7 + 1, 1, name, static_cast<EventKind>(i % 8)};
+}
+
+static void BM_text_sink(benchmark::State &state)
+{
+  std::vector<Event> ev(EventRing::capacity);
+  for (std::size_t i = 0; i < ev.size(); ++i)
+    ev[i] = text_event(i);
+  const int fd = ::open("/dev/null", O_WRONLY);
+  auto sink = std::make_unique<TextSink>(fd);
+  for (auto _ : state)
+    sink->consume(ev.data(), ev.size());
+  ::close(fd);
+  state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(ev.size()));
+}
+BENCHMARK(BM_text_sink);
+
+static void BM_text_ostream(benchmark::State &state)
+{
+  std::vector<Event> ev(EventRing::capacity);
+  for (std::size_t i = 0; i < ev.size(); ++i)
+    ev[i] = text_event(i);
+  std::ofstream os{"/dev/null"};
+  for (auto _ : state) {
+    for (const Event &e : ev) {
+      os << "#constructor      " << "cnt_p " << e.cnt_p << " \tthis " << e.obj << " \t" << e.name
+         << " (" << e.count << ')';
+      if (e.batch != 1)
+        os << " \t[bulk: " << e.batch << " instances]";
+      os << '\n';
+    }
+    os.flush();
+  }
+  state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(ev.size()));
+}
+BENCHMARK(BM_text_ostream);
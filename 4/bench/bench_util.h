@@ -0,0 +1,30 @@
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+#include <cstdint>
+#include <thread>
+
+#include <benchmark/benchmark.h>
+
+#include "../eventlog.h"
+
+inline int max_threads()
+{
+  const unsigned n = std::thread::hardware_concurrency();
+  return n ? static_cast<int>(n) : 1;
+}
+
+inline void discard_events()   // monitored benchmarks: events are recorded and drained, but not printed
+{
+  static const bool once = (EventLog::instance().clear_sinks(), true);
+  (void)once;
+}
+
+inline void set_objects_processed(benchmark::State &state, std::int64_t n)   // reports items/s and time per object
+{
+  state.SetItemsProcessed(n);
+  state.counters["per_object"] = benchmark::Counter(static_cast<double>(n),
+                                                    benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+#endif
@@ -0,0 +1,252 @@
+#ifndef CHROMETRACE_H
+#define CHROMETRACE_H
+
+#include <cerrno>
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "eventlog.h"
+#include "timeorder.h"
+
+/*
+  Chrome Trace Event (JSON) export of lifecycle events, for a timeline view (chrome://tracing, ui.perfetto.dev).
+
+  Each value group (cnt_p) is an async track (cat "value", id cnt_p, name: the name of the value):
+  .    a span (ph b / e) from the group's creation until its last instance is gone
+  .    an instant (ph n) per event on the way: copies, moves, assignments, detach, destructions (args: event, this, count)
+  Groups still alive at the end stay open (leaks show up as unfinished spans).
+  Dropped events (ring buffer full) are global instants "dropped".
+
+  The drainer delivers events ring after ring: they are put back into time order first (TimeOrder, see timeorder.h),
+  so that a group shared between threads is rebuilt in the order its events happened. At the end, a global instant
+  "orphans" counts the events of groups not seen created and the events that arrived too late to be ordered.
+
+  JSON array format, one event per line; a missing closing ']' (process killed) is accepted by the viewers.
+  ChromeTraceSink is an EventSink: it runs on the EventLog drainer thread, behind the bounded per-thread rings,
+  which drop (counting) rather than block the monitored threads -- I/O never happens on their hot path.
+ */
+
+class ChromeTraceSink : public EventSink
+/*
+  Writes events as Chrome Trace Event JSON to a file; buffered, written with write(2) per drained batch (and on flush).
+  Value groups are counted as by the live-object Registry (see registry.h), to know when a group ends.
+ */
+{
+public:
+  explicit ChromeTraceSink(const std::string &path)
+    : pid{static_cast<std::uint64_t>(::getpid())}
+  {
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+      throw std::system_error{errno, std::generic_category(), "ChromeTraceSink: open " + path};
+    buf.reserve(buf_size);
+    buf += "[\n";
+  }
+
+  ChromeTraceSink(const ChromeTraceSink &) = delete;
+  ChromeTraceSink &operator=(const ChromeTraceSink &) = delete;
+
+  ~ChromeTraceSink() override
+  {
+    order.release_all([this](const Event &e) { process(e); });
+    if (orphans || order.late()) {
+      open_event("orphans", "i", Event::now());
+      buf += ",\"s\":\"g\",\"args\":{\"unknown group\":";
+      append(orphans);
+      buf += ",\"late\":";
+      append(order.late());
+      buf += "}}";
+    }
+    buf += "\n]\n";
+    write_out();
+    ::close(fd);
+  }
+
+  void consume(const Event *ev, std::size_t n) override
+  {
+    for (std::size_t i = 0; i < n; ++i) {
+      const bool assign = ev[i].kind == EventKind::assign || ev[i].kind == EventKind::move_assign;
+      order.push(ev[i], assign, [this](const Event &e) { process(e); });
+    }
+    write_out();
+  }
+
+  void dropped(std::size_t n) override
+  {
+    open_event("dropped", "i", Event::now());
+    buf += ",\"s\":\"g\",\"args\":{\"events\":";
+    append(n);
+    buf += "}}";
+  }
+
+  void flush() override   // (all rings drained: the events held back for ordering can go)
+  {
+    order.release_all([this](const Event &e) { process(e); });
+    write_out();
+  }
+
+private:
+  static constexpr std::size_t buf_size = 64 * 1024;
+
+  void process(const Event &e)
+  {
+    if (skip_next) {   // assign_result after move_assign: rhs's instance is taken over
+      skip_next = false;
+      instant(e);
+      return;
+    }
+    switch (e.kind) {
+    case EventKind::constructor:      begin(e);                  break;
+    case EventKind::copy_constructor: update(e, +static_cast<std::ptrdiff_t>(e.batch)); break;
+    case EventKind::assign_result:    update(e, +1);             break;
+    case EventKind::move_assign:      skip_next = true;          [[fallthrough]];   // (this drops its old value)
+    case EventKind::assign:           update(e, -1);             break;
+    case EventKind::detach:           update(e, -1);             break;
+    case EventKind::destructor:       update(e, -static_cast<std::ptrdiff_t>(e.batch)); break;
+    default:                          instant(e);                break;
+    }
+    if (buf.size() >= buf_size)
+      write_out();
+  }
+
+  void begin(const Event &e)
+  {
+    groups[e.cnt_p] = 1;
+    async(e, "b");
+    buf += '}';
+    instant(e);
+  }
+
+  void update(const Event &e, std::ptrdiff_t d)
+  {
+    instant(e);
+    const auto it = groups.find(e.cnt_p);
+    if (it == groups.end()) {   // moved-from instance, unsampled group, or group created before the sink was added
+      if (e.cnt_p != nullptr)
+        ++orphans;
+      return;
+    }
+    it->second += d;
+    if (it->second > 0)
+      return;
+    groups.erase(it);
+    async(e, "e");
+    buf += '}';
+  }
+
+  void instant(const Event &e)
+  {
+    if (e.cnt_p == nullptr)
+      return;   // moved-from: on no track
+    async(e, "n");
+    buf += ",\"args\":{\"event\":\"";
+    buf += label(e.kind);
+    buf += "\",\"this\":\"";
+    append_hex(reinterpret_cast<std::uintptr_t>(e.obj));
+    buf += "\",\"count\":";
+    append(e.count);
+    if (e.batch != 1) {
+      buf += ",\"batch\":";
+      append(e.batch);
+    }
+    buf += "}}";
+  }
+
+  void async(const Event &e, const char *ph)
+  {
+    open_event(e.name.view(), ph, e.timestamp);
+    buf += ",\"cat\":\"value\",\"id\":\"";
+    append_hex(reinterpret_cast<std::uintptr_t>(e.cnt_p));
+    buf += '"';
+  }
+
+  // {"name":..,"ph":..,"ts":..,"pid":..,"tid":0   (not closed)
+  void open_event(std::string_view name, const char *ph, std::uint64_t ts)
+  {
+    buf += first ? "{\"name\":\"" : ",\n{\"name\":\"";
+    first = false;
+    append_escaped(name.empty() ? std::string_view{"(no name)"} : name);
+    buf += "\",\"ph\":\"";
+    buf += ph;
+    buf += "\",\"ts\":";
+    append(ts / 1000U);   // [us], with ns resolution
+    buf += '.';
+    const std::uint64_t ns = ts % 1000U;
+    buf += static_cast<char>('0' + ns / 100U);
+    buf += static_cast<char>('0' + ns / 10U % 10U);
+    buf += static_cast<char>('0' + ns % 10U);
+    buf += ",\"pid\":";
+    append(pid);
+    buf += ",\"tid\":0";
+  }
+
+  static const char *label(EventKind kind)
+  {
+    switch (kind) {
+    case EventKind::constructor:      return "constructor";
+    case EventKind::copy_constructor: return "copy-constructor";
+    case EventKind::move_constructor: return "move-constructor";
+    case EventKind::assign:           return "operator=";
+    case EventKind::move_assign:      return "move-assign";
+    case EventKind::assign_result:    return "operator= result";
+    case EventKind::assign_same:      return "operator= same value";
+    case EventKind::destructor:       return "destructor";
+    case EventKind::detach:           return "detach";
+    }
+    return "";
+  }
+
+  void append(std::uint64_t v)
+  {
+    char s[20];
+    buf.append(s, std::to_chars(s, s + sizeof(s), v).ptr);
+  }
+
+  void append_hex(std::uint64_t v)
+  {
+    char s[18] = {'0', 'x'};
+    buf.append(s, std::to_chars(s + 2, s + sizeof(s), v, 16).ptr);
+  }
+
+  void append_escaped(std::string_view s)
+  {
+    static constexpr char hex[] = "0123456789abcdef";
+    for (const char c : s) {
+      const unsigned char u = static_cast<unsigned char>(c);
+      if (c == '"' || c == '\\') {
+        buf += '\\';
+        buf += c;
+      } else if (u < 0x20) {
+        buf += "\\u00";
+        buf += hex[u >> 4];
+        buf += hex[u & 0xF];
+      } else {
+        buf += c;
+      }
+    }
+  }
+
+  void write_out()
+  {
+    write_all(fd, buf.data(), buf.size());
+    buf.clear();
+  }
+
+  int                                               fd = -1;
+  std::uint64_t                                     pid;
+  std::string                                       buf;
+  bool                                              first     = true;
+  bool                                              skip_next = false;
+  std::uint64_t                                     orphans   = 0;   // events of groups not seen created
+  TimeOrder<Event>                                  order;
+  std::unordered_map<const void *, std::ptrdiff_t>  groups;   // live groups: instances, by cnt_p
+};
+
+#endif
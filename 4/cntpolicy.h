@@ -0,0 +1,271 @@
+#ifndef CNTPOLICY_H
+#define CNTPOLICY_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "alloc.h"
+
+/*
+  Counter policies for RefCount / RefCountOnly.
+
+  A policy defines the counter type (cnt_t, the memory for which is either allocated on the heap
+  or passed in from the outside) and the operations of the reference counting mechanism:
+  .    init(c)   *cnt_p = 1
+  .    inc(c)    ++*cnt_p                     (additional instance "of the same value")
+  .    dec(c)    --*cnt_p, returns true if 0  (one less   instance "of the same value" -> delete)
+  .    add(c, n) *cnt_p += n                  (bulk: n additional instances)
+  .    sub(c, n) *cnt_p -= n, returns true if 0
+  .    load(c)   current number of instances
+  and whether decrements of RefCount's heap blocks are deferred (see CntDeferred),
+  and whether the counter also holds a weak count (see CntWeak).
+ */
+
+struct CntPlain
+/*
+  Non-atomic: fastest, but instances "of the same value" must not be copied/destroyed concurrently from several threads.
+ */
+{
+  using cnt_t = std::size_t;
+  static constexpr bool thread_safe = false;
+  static constexpr bool deferred    = false;
+  static constexpr bool weak        = false;
+
+  static void        init(cnt_t &c)       { c = 1U; }
+  static void        inc(cnt_t &c)        { ++c; }
+  static bool        dec(cnt_t &c)        { return --c == 0; }
+  static void        add(cnt_t &c, std::size_t n) { c += n; }
+  static bool        sub(cnt_t &c, std::size_t n) { return (c -= n) == 0; }
+  static std::size_t load(const cnt_t &c) { return c; }
+};
+
+
+struct CntAtomic
+/*
+  Atomic: instances "of the same value" may be shared across threads.
+
+  Increment is relaxed (a new instance can only be made from an existing one, which already keeps the value alive).
+  Decrement is acq_rel, so that all accesses to the data by other instances happen-before the delete.
+ */
+{
+  using cnt_t = std::atomic<std::size_t>;
+  static constexpr bool thread_safe = true;
+  static constexpr bool deferred    = false;
+  static constexpr bool weak        = false;
+
+  static void        init(cnt_t &c)       { c.store(1U, std::memory_order_relaxed); }
+  static void        inc(cnt_t &c)        { c.fetch_add(1U, std::memory_order_relaxed); }
+  static bool        dec(cnt_t &c)        { return c.fetch_sub(1U, std::memory_order_acq_rel) == 1U; }
+  static void        add(cnt_t &c, std::size_t n) { c.fetch_add(n, std::memory_order_relaxed); }
+  static bool        sub(cnt_t &c, std::size_t n) { return c.fetch_sub(n, std::memory_order_acq_rel) == n; }
+  static std::size_t load(const cnt_t &c) { return c.load(std::memory_order_acquire); }
+};
+
+
+struct CntDeferred
+/*
+  Atomic, with deferred decrements (deferred reference counting), for hot values shared by many threads.
+
+  RefCount does not decrement the shared counter of a heap block (ControlBlock) right away, but buffers
+  the decrement in a small thread-local table (pending decrements per counter), together with how to release the block.
+  An increment first cancels a pending decrement of the same counter on the same thread, and only else
+  touches the shared counter: a thread that keeps copying and destroying instances of a hot value
+  mostly works on its own table.
+
+  Pending decrements are applied (flushed) when their slot is needed for another counter,
+  by flush() / DeferredScope, and at thread exit; the flushing thread then releases the block, if the count drops to 0.
+  After the thread's table is flushed at thread exit (e.g. for a static instance destroyed late), decrements are
+  applied immediately.
+  The shared counter never drops below the true count, so a block is only released once no instance is left.
+  load() (use_count) is an upper bound while decrements are pending.
+
+  Other instances (memory from the outside or from an arena) and RefCountOnly decrement immediately (dec, sub).
+ */
+{
+  using cnt_t = std::atomic<std::size_t>;
+  static constexpr bool thread_safe = true;
+  static constexpr bool deferred    = true;
+  static constexpr bool weak        = false;
+
+  static void        init(cnt_t &c)       { c.store(1U, std::memory_order_relaxed); }
+  static void        inc(cnt_t &c)
+  {
+    Slot *s = slot(&c);
+    if (s && s->cnt == &c && s->n) {
+      --s->n;
+      return;
+    }
+    c.fetch_add(1U, std::memory_order_relaxed);
+  }
+  static bool        dec(cnt_t &c)        { return c.fetch_sub(1U, std::memory_order_acq_rel) == 1U; }
+  static void        add(cnt_t &c, std::size_t n) { c.fetch_add(n, std::memory_order_relaxed); }
+  static bool        sub(cnt_t &c, std::size_t n) { return c.fetch_sub(n, std::memory_order_acq_rel) == n; }
+  static std::size_t load(const cnt_t &c) { return c.load(std::memory_order_acquire); }
+
+  // buffers n decrements of c; release(&c) is called (by the flushing thread) when the count drops to 0
+  static void defer(cnt_t &c, std::size_t n, void (*release)(void *cnt))
+  {
+    Slot *s = slot(&c);
+    if (s == nullptr) {   // thread exit, after the table was flushed (e.g. a static instance destroyed late)
+      if (c.fetch_sub(n, std::memory_order_acq_rel) == n)
+        release(&c);
+      return;
+    }
+    if (s->cnt == &c) {
+      s->n      += n;
+      s->release = release;
+      return;
+    }
+    Slot old = *s;   // (taken out first: its release may defer again, into this very slot)
+    *s = Slot{&c, n, release};
+    apply(old);
+  }
+
+  // applies all pending decrements of this thread
+  static void flush()
+  {
+    Table *t = table();
+    if (t == nullptr)
+      return;
+    Slot *slots = t->slots;
+    for (bool again = true; again; ) {   // (a release may defer further decrements)
+      again = false;
+      for (std::size_t i = 0; i < n_slots; ++i)
+        again |= apply(slots[i]);
+    }
+  }
+
+private:
+  static constexpr std::size_t n_slots = 64;   // direct-mapped by the address of the counter
+
+  struct Slot {
+    cnt_t        *cnt = nullptr;
+    std::size_t   n   = 0;
+    void        (*release)(void *) = nullptr;
+  };
+
+  struct Table {   // trivially destructible: still valid after Handle is destroyed
+    Slot slots[n_slots];
+    bool live   = false;
+    bool exited = false;
+  };
+
+  struct Handle {   // flushes the table at thread exit; decrements after that are applied immediately
+    ~Handle()
+    {
+      flush();
+      Table &t = tls();
+      t.live   = false;
+      t.exited = true;
+    }
+  };
+
+  static Table &tls()
+  {
+    thread_local Table t;
+    return t;
+  }
+
+  static Table *table()   // null once the thread's table is flushed at thread exit
+  {
+    Table &t = tls();
+    if (! t.live) {
+      if (t.exited)
+        return nullptr;
+      t.live = true;
+      Pool::attach();   // the thread's Pool is constructed first: it outlives the flush at thread exit
+      thread_local Handle handle;
+      (void)handle;
+    }
+    return &t;
+  }
+
+  static Slot *slot(const cnt_t *c)
+  {
+    Table *t = table();
+    if (t == nullptr)
+      return nullptr;
+    const std::uintptr_t a = reinterpret_cast<std::uintptr_t>(c) >> 4;
+    return &t->slots[(a * 0x9E3779B97F4A7C15ULL) >> 58];   // top 6 bits: n_slots == 64
+  }
+
+  static bool apply(Slot &s)
+  {
+    const Slot old = s;   // (s may be reused by a defer() from within release)
+    if (old.n == 0)
+      return false;
+    s.n = 0;
+    if (old.cnt->fetch_sub(old.n, std::memory_order_acq_rel) == old.n)
+      old.release(old.cnt);
+    return true;
+  }
+};
+
+
+template <typename Strong = CntAtomic>
+struct CntWeak
+/*
+  Strong count (of instances "of the same value", with the operations of Strong: CntPlain or CntAtomic)
+  plus a weak count (of WeakRefs, see weakref.h), both in the counter -- i.e. in the ControlBlock.
+
+  As with std::shared_ptr, the instances together hold one weak reference: the weak count starts at 1, and drops
+  when the last instance is gone. RefCount then destroys the value right away, but releases the counter
+  (and the memory of a ControlBlock) only when the weak count drops to 0.
+
+  inc_not_zero(c) (WeakRef::lock): increments the strong count, unless it is 0 (the value is gone).
+ */
+{
+  static_assert(! Strong::deferred && ! Strong::weak, "CntWeak: Strong must be CntPlain or CntAtomic");
+
+  struct cnt_t {
+    typename Strong::cnt_t strong;
+    typename Strong::cnt_t weak;
+  };
+  static constexpr bool thread_safe = Strong::thread_safe;
+  static constexpr bool deferred    = false;
+  static constexpr bool weak        = true;
+
+  static void        init(cnt_t &c)       { Strong::init(c.strong); Strong::init(c.weak); }
+  static void        inc(cnt_t &c)        { Strong::inc(c.strong); }
+  static bool        dec(cnt_t &c)        { return Strong::dec(c.strong); }
+  static void        add(cnt_t &c, std::size_t n) { Strong::add(c.strong, n); }
+  static bool        sub(cnt_t &c, std::size_t n) { return Strong::sub(c.strong, n); }
+  static std::size_t load(const cnt_t &c) { return Strong::load(c.strong); }
+
+  static void        weak_inc(cnt_t &c)        { Strong::inc(c.weak); }
+  static bool        weak_dec(cnt_t &c)        { return Strong::dec(c.weak); }
+  static std::size_t weak_load(const cnt_t &c) { return Strong::load(c.weak); }
+
+  static bool inc_not_zero(cnt_t &c)
+  {
+    if constexpr (Strong::thread_safe) {
+      std::size_t n = c.strong.load(std::memory_order_relaxed);
+      do {
+        if (n == 0)
+          return false;
+      } while (! c.strong.compare_exchange_weak(n, n + 1U, std::memory_order_acq_rel, std::memory_order_relaxed));
+      return true;
+    } else {
+      if (c.strong == 0)
+        return false;
+      ++c.strong;
+      return true;
+    }
+  }
+};
+
+
+class DeferredScope
+/*
+  Flushes the pending decrements of this thread (CntDeferred) at the end of the scope.
+ */
+{
+public:
+  DeferredScope() = default;
+  DeferredScope(const DeferredScope &) = delete;
+  DeferredScope &operator=(const DeferredScope &) = delete;
+  ~DeferredScope() { CntDeferred::flush(); }
+};
+
+#endif
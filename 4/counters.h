@@ -0,0 +1,272 @@
+#ifndef COUNTERS_H
+#define COUNTERS_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+#include "eventlog.h"
+
+/*
+  Aggregate lifecycle counters per name (typically: per class) and event kind, see MonitorCounted (monitor.h):
+  "how many MyClass were constructed / copied / assigned / destroyed", without recording single events.
+
+  EventCounters     per-thread shards (single writer: one relaxed load + store, no read-modify-write,
+  .                 no cache line shared with another writer), summed up on read (totals())
+  CounterReporter   background thread printing the rates [1/s] of each name every interval
+ */
+
+constexpr std::size_t n_event_kinds = static_cast<std::size_t>(EventKind::detach) + 1;
+
+class EventCounters
+/*
+  Per thread: a row of counters per name, found by the name's dense id (two-level table, no lock; as Histograms).
+  A chunk of rows is allocated once per thread, on first use of one of its names; counting itself does not allocate.
+  At thread exit, a thread's counts are folded into the totals of retired threads.
+  Instances destroyed later in that thread (e.g. static ones) are not counted.
+ */
+{
+public:
+  struct Totals {
+    Symbol        name;
+    std::uint64_t n[n_event_kinds];
+  };
+
+  static void add(Symbol name, EventKind kind, std::size_t n = 1)   // (empty name, too many names, or after thread exit: not counted)
+  {
+    if (Table *t = thread_table())
+      t->add(name, kind, n);
+  }
+
+  static std::vector<Totals> totals()
+  {
+    EventCounters &c = instance();
+    std::lock_guard<std::mutex> lock{c.mtx};
+    std::vector<Totals> res = c.retired;
+    for (const Table *t : c.tables)
+      t->merge_into(res);
+    return res;
+  }
+
+private:
+  static constexpr std::size_t chunk_size = 256;
+  static constexpr std::size_t n_chunks   = 64;   // up to 16384 names
+
+  struct Row {
+    std::atomic<std::uint64_t> n[n_event_kinds] = {};
+    Symbol                     name;
+    std::atomic<bool>          used{false};   // name is written before
+  };
+
+  struct alignas(64) Chunk {   // (the shards of two threads never share a cache line)
+    Row rows[chunk_size];
+  };
+
+  class Table {
+  public:
+    Table()
+    {
+      EventCounters &c = instance();
+      std::lock_guard<std::mutex> lock{c.mtx};
+      c.tables.push_back(this);
+    }
+
+    ~Table()
+    {
+      EventCounters &c = instance();
+      {
+        std::lock_guard<std::mutex> lock{c.mtx};
+        merge_into(c.retired);
+        c.tables.erase(std::find(c.tables.begin(), c.tables.end(), this));
+      }
+      for (auto &chunk : chunks)
+        delete chunk.load(std::memory_order_relaxed);
+    }
+
+    void add(Symbol name, EventKind kind, std::size_t n)
+    {
+      const std::uint32_t id = name.id();
+      if (id == 0 || id >= chunk_size * n_chunks)
+        return;
+      Chunk *chunk = chunks[id / chunk_size].load(std::memory_order_relaxed);
+      if (chunk == nullptr) {
+        chunk = new Chunk;
+        chunks[id / chunk_size].store(chunk, std::memory_order_release);
+      }
+      Row &row = chunk->rows[id % chunk_size];
+      if (! row.used.load(std::memory_order_relaxed)) {
+        row.name = name;
+        row.used.store(true, std::memory_order_release);
+      }
+      std::atomic<std::uint64_t> &cnt = row.n[static_cast<std::size_t>(kind)];
+      cnt.store(cnt.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    void merge_into(std::vector<Totals> &res) const   // (called with the EventCounters mutex held)
+    {
+      for (std::size_t c = 0; c < n_chunks; ++c) {
+        const Chunk *chunk = chunks[c].load(std::memory_order_acquire);
+        if (chunk == nullptr)
+          continue;
+        for (const Row &row : chunk->rows) {
+          if (! row.used.load(std::memory_order_acquire))
+            continue;
+          const Symbol name = row.name;
+          auto it = std::find_if(res.begin(), res.end(), [name](const Totals &t) { return t.name == name; });
+          if (it == res.end()) {
+            res.push_back(Totals{name, {}});
+            it = res.end() - 1;
+          }
+          for (std::size_t k = 0; k < n_event_kinds; ++k)
+            it->n[k] += row.n[k].load(std::memory_order_relaxed);
+        }
+      }
+    }
+
+  private:
+    std::atomic<Chunk *> chunks[n_chunks] = {};
+  };
+
+  static EventCounters &instance()
+  {
+    static EventCounters *c = new EventCounters;   // never destroyed: threads may exit during static destruction
+    return *c;
+  }
+
+  struct Local {   // trivially destructible: still valid after Handle is destroyed
+    Table *table  = nullptr;
+    bool   exited = false;
+  };
+
+  struct Handle {   // retires the thread's table at thread exit: no counting after that
+    ~Handle()
+    {
+      Local &l = tls();
+      delete l.table;
+      l.table  = nullptr;
+      l.exited = true;
+    }
+  };
+
+  static Local &tls()
+  {
+    thread_local Local l;
+    return l;
+  }
+
+  static Table *thread_table()   // null once the thread's table is retired
+  {
+    Local &l = tls();
+    if (l.table == nullptr && ! l.exited) {
+      l.table = new Table;
+      thread_local Handle handle;
+      (void)handle;
+    }
+    return l.table;
+  }
+
+  std::mutex           mtx;
+  std::vector<Table*>  tables;    // of live threads
+  std::vector<Totals>  retired;   // summed counts of exited threads
+};
+
+
+
+class CounterReporter
+/*
+  Prints, every interval, the rate [1/s] of each event kind per name, since the previous report
+  (names without events in the interval are left out):
+    rates [1/s]  MyClass    ctor 120000   copy 480000   dtor 600000
+  The reporter runs on its own thread, from construction until destruction.
+ */
+{
+public:
+  explicit CounterReporter(std::ostream &os_ = std::cerr,
+                           std::chrono::milliseconds interval_ = std::chrono::milliseconds{1000})
+    : os(os_), interval(interval_), prev{EventCounters::totals()}, prev_t{std::chrono::steady_clock::now()}
+  {
+    reporter = std::thread{[this] { run(); }};
+  }
+
+  CounterReporter(const CounterReporter &) = delete;
+  CounterReporter &operator=(const CounterReporter &) = delete;
+
+  ~CounterReporter()
+  {
+    {
+      std::lock_guard<std::mutex> lock{mtx};
+      stop = true;
+    }
+    wake.notify_one();
+    reporter.join();
+  }
+
+private:
+  void report()
+  {
+    const auto now = std::chrono::steady_clock::now();
+    const double secs = std::chrono::duration<double>(now - prev_t).count();
+    std::vector<EventCounters::Totals> cur = EventCounters::totals();
+    for (const EventCounters::Totals &t : cur) {
+      const auto p = std::find_if(prev.begin(), prev.end(), [&t](const EventCounters::Totals &x) { return x.name == t.name; });
+      bool any = false;
+      for (std::size_t k = 0; k < n_event_kinds; ++k) {
+        const std::uint64_t d = t.n[k] - (p == prev.end() ? 0U : p->n[k]);
+        if (d == 0)
+          continue;
+        if (! any)
+          os << "rates [1/s]  " << std::left << std::setw(16) << t.name << std::right;
+        any = true;
+        os << "  " << label(static_cast<EventKind>(k)) << ' ' << std::setw(10)
+           << static_cast<std::uint64_t>(static_cast<double>(d) / secs);
+      }
+      if (any)
+        os << '\n';
+    }
+    os.flush();
+    prev   = std::move(cur);
+    prev_t = now;
+  }
+
+  static const char *label(EventKind kind)
+  {
+    switch (kind) {
+    case EventKind::constructor:      return "ctor";
+    case EventKind::copy_constructor: return "copy";
+    case EventKind::move_constructor: return "move";
+    case EventKind::assign:           return "assign";
+    case EventKind::move_assign:      return "move-assign";
+    case EventKind::assign_result:    return "assign-result";
+    case EventKind::assign_same:      return "assign-same";
+    case EventKind::destructor:       return "dtor";
+    case EventKind::detach:           return "detach";
+    }
+    return "";
+  }
+
+  void run()
+  {
+    std::unique_lock<std::mutex> lock{mtx};
+    while (! wake.wait_for(lock, interval, [this] { return stop; }))
+      report();
+  }
+
+  std::ostream                         &os;
+  std::chrono::milliseconds             interval;
+  std::vector<EventCounters::Totals>    prev;
+  std::chrono::steady_clock::time_point prev_t;
+
+  std::mutex                            mtx;
+  std::condition_variable               wake;
+  bool                                  stop = false;
+  std::thread                           reporter;
+};
+
+#endif
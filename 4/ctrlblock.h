@@ -0,0 +1,84 @@
+#ifndef CTRLBLOCK_H
+#define CTRLBLOCK_H
+
+#include <cstddef>
+#include <new>
+#include <utility>
+
+#include "alloc.h"
+
+template <typename C, typename T, typename Alloc = PoolAlloc>
+struct ControlBlock
+/*
+  Single heap allocation holding the counter and the data of a value group (as std::make_shared does):
+
+  .    [ C cnt | padding | T data ]
+
+  The counter is at offset 0, so a block is identified (and destroyed) by the address of its counter.
+
+  While an ArenaScope is active, the block is drawn from the Arena instead (create() reports on_heap = false),
+  and destroyed when the arena is released.
+ */
+{
+  static constexpr std::size_t align       = alignof(C) > alignof(T) ? alignof(C) : alignof(T);
+  static constexpr std::size_t data_offset = (sizeof(C) + alignof(T) - 1) / alignof(T) * alignof(T);
+  static constexpr std::size_t size        = data_offset + sizeof(T);
+
+  struct Created {
+    C   *cnt;
+    bool on_heap;
+  };
+
+  template <typename... Args>
+  static Created create(Args&&... args)
+  {
+    Arena *arena = Arena::current();
+    void *mem = arena ? arena->allocate(size, align) : Alloc::allocate(size, align);
+    C *cnt = new (mem) C{};
+    try {
+      new (static_cast<unsigned char *>(mem) + data_offset) T(std::forward<Args>(args)...);
+    }
+    catch (...) {
+      cnt->~C();
+      if (! arena)
+        Alloc::deallocate(mem, size, align);
+      throw;
+    }
+    if (arena) {
+      arena->on_release([](void *c) { destroy_in_place(static_cast<C *>(c)); }, cnt);
+      return Created{cnt, false};
+    }
+    return Created{cnt, true};
+  }
+
+  static T *data(C *cnt)
+  {
+    return std::launder(reinterpret_cast<T *>(reinterpret_cast<unsigned char *>(cnt) + data_offset));
+  }
+
+  static void destroy(C *cnt)
+  {
+    destroy_in_place(cnt);
+    Alloc::deallocate(static_cast<void *>(cnt), size, align);
+  }
+
+  // in two steps (weak references, see CntWeak): the data when the last instance is gone, the block when the last weak one is
+  static void destroy_data(C *cnt)
+  {
+    data(cnt)->~T();
+  }
+
+  static void deallocate(C *cnt)
+  {
+    cnt->~C();
+    Alloc::deallocate(static_cast<void *>(cnt), size, align);
+  }
+
+  static void destroy_in_place(C *cnt)
+  {
+    data(cnt)->~T();
+    cnt->~C();
+  }
+};
+
+#endif
@@ -0,0 +1,212 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/*
+  Epoch-based reclamation (EBR): memory unlinked from a shared structure is only freed once no reader
+  can still hold a pointer to it. Used by AtomicRefCount (see atomicrefcount.h).
+
+  EpochGuard     marks the calling thread as reading (critical section, may nest): it may dereference
+  .              pointers loaded from shared structures until the guard ends (lock-free: two stores, one fence)
+  Epoch::retire  hands over unlinked memory with its deleter: freed once every thread that was reading
+  .              at the time of the retire has left its critical section (two epochs later)
+
+  Each thread keeps its retired memory in three buckets, by epoch; every retire_batch retires, it tries
+  to advance the global epoch (possible once all reading threads have seen the current one) and frees
+  the buckets that are old enough. Memory of exited threads is freed by the next thread that collects.
+ */
+
+class Epoch {
+public:
+  static void retire(void *p, void (*del)(void *))
+  {
+    thread_state().retire(Retired{p, del});
+  }
+
+  // advances the epoch, if possible, and frees what is safe to free (retired memory is also collected on its own)
+  static void collect()
+  {
+    thread_state().collect();
+  }
+
+private:
+  friend class EpochGuard;
+
+  static constexpr std::size_t retire_batch = 64;
+
+  struct Retired {
+    void  *p;
+    void (*del)(void *);
+  };
+
+  struct Bucket {
+    std::uint64_t        epoch = 0;
+    std::vector<Retired> items;
+
+    void free_all()
+    {
+      std::vector<Retired> v;
+      v.swap(items);   // (a deleter may retire further memory)
+      for (const Retired &r : v)
+        r.del(r.p);
+    }
+  };
+
+  struct Record {   // per thread; never freed, reused after the thread exits
+    std::atomic<std::uint64_t> local{0};   // epoch << 1 | active
+    std::atomic<bool>          in_use{true};
+    Record                    *next = nullptr;
+  };
+
+  class ThreadState {
+  public:
+    ThreadState() : rec{instance().acquire_record()} {}
+
+    ~ThreadState()
+    {
+      Epoch &g = instance();
+      {
+        std::lock_guard<std::mutex> lock{g.mtx};
+        for (Bucket &b : buckets)
+          for (const Retired &r : b.items)
+            g.orphans.push_back(Orphan{b.epoch, r});
+      }
+      rec->local.store(0, std::memory_order_release);
+      rec->in_use.store(false, std::memory_order_release);
+    }
+
+    void enter()
+    {
+      if (depth++ == 0) {
+        rec->local.store(instance().global.load(std::memory_order_relaxed) << 1 | 1U, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);   // (the store must be visible before any shared load)
+      }
+    }
+
+    void exit()
+    {
+      if (--depth == 0)
+        rec->local.store(0, std::memory_order_release);
+    }
+
+    void retire(const Retired &r)
+    {
+      const std::uint64_t e = instance().global.load(std::memory_order_acquire);
+      Bucket &b = buckets[e % 3];
+      if (b.epoch != e) {   // (b.epoch <= e - 3: safe)
+        b.free_all();
+        b.epoch = e;
+      }
+      b.items.push_back(r);
+      if (++n_retired % retire_batch == 0)
+        collect();
+    }
+
+    void collect()
+    {
+      Epoch &g = instance();
+      g.try_advance();
+      const std::uint64_t e = g.global.load(std::memory_order_acquire);
+      for (Bucket &b : buckets)
+        if (b.epoch + 2 <= e)
+          b.free_all();
+      g.collect_orphans(e);
+    }
+
+  private:
+    Record       *rec;
+    std::size_t   depth     = 0;
+    std::size_t   n_retired = 0;
+    Bucket        buckets[3];
+  };
+
+  struct Orphan {
+    std::uint64_t epoch;
+    Retired       r;
+  };
+
+  static Epoch &instance()
+  {
+    static Epoch *e = new Epoch;   // never destroyed: threads may exit during static destruction
+    return *e;
+  }
+
+  static ThreadState &thread_state()
+  {
+    thread_local ThreadState s;
+    return s;
+  }
+
+  Record *acquire_record()
+  {
+    for (Record *r = records.load(std::memory_order_acquire); r; r = r->next) {
+      bool free = false;
+      if (! r->in_use.load(std::memory_order_relaxed) && r->in_use.compare_exchange_strong(free, true))
+        return r;
+    }
+    Record *r = new Record;
+    Record *head = records.load(std::memory_order_relaxed);
+    do {
+      r->next = head;
+    } while (! records.compare_exchange_weak(head, r, std::memory_order_release, std::memory_order_relaxed));
+    return r;
+  }
+
+  // the epoch moves on once every reading thread has entered the current one
+  void try_advance()
+  {
+    std::uint64_t e = global.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    for (Record *r = records.load(std::memory_order_acquire); r; r = r->next) {
+      const std::uint64_t l = r->local.load(std::memory_order_acquire);   // (pairs with exit())
+      if ((l & 1U) && (l >> 1) != e)
+        return;
+    }
+    global.compare_exchange_strong(e, e + 1, std::memory_order_acq_rel, std::memory_order_relaxed);
+  }
+
+  void collect_orphans(std::uint64_t e)
+  {
+    std::vector<Orphan> ready;
+    {
+      std::unique_lock<std::mutex> lock{mtx, std::try_to_lock};
+      if (! lock || orphans.empty())
+        return;
+      auto keep = orphans.begin();
+      for (Orphan &o : orphans)
+        if (o.epoch + 2 <= e)
+          ready.push_back(o);
+        else
+          *keep++ = o;
+      orphans.erase(keep, orphans.end());
+    }
+    for (const Orphan &o : ready)   // (outside the lock: a deleter may retire further memory)
+      o.r.del(o.r.p);
+  }
+
+  std::atomic<std::uint64_t> global{2};   // (buckets start at epoch 0: already safe)
+  std::atomic<Record *>      records{nullptr};
+  std::mutex                 mtx;
+  std::vector<Orphan>        orphans;   // retired memory of exited threads
+};
+
+
+class EpochGuard
+/*
+  Critical section of a reader (see Epoch): pointers loaded from shared structures stay valid until the guard ends.
+ */
+{
+public:
+  EpochGuard()  { Epoch::thread_state().enter(); }
+  ~EpochGuard() { Epoch::thread_state().exit(); }
+
+  EpochGuard(const EpochGuard &) = delete;
+  EpochGuard &operator=(const EpochGuard &) = delete;
+};
+
+#endif
@@ -0,0 +1,478 @@
+#ifndef EVENTLOG_H
+#define EVENTLOG_H
+
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "symbol.h"
+
+enum class EventKind : std::uint8_t {
+  constructor,
+  copy_constructor,
+  move_constructor,
+  assign,            // state before operator=,       always followed by assign_result
+  move_assign,       // state before move operator=,  always followed by assign_result
+  assign_result,     // state after  operator=
+  assign_same,       // operator= with rhs already holding the same value
+  destructor,
+  detach             // state before a copy-on-write detach (this leaves its group; the new group: #constructor)
+};
+
+struct Event
+/*
+  Fixed-size binary record of one lifecycle event (fits into one cache line).
+
+  The name is an interned Symbol (see symbol.h): it stays valid after the value group is deleted,
+  so the record only carries the pointer.
+ */
+{
+  std::uint64_t timestamp;   // steady_clock [ns]
+  const void   *obj;         // this
+  const void   *cnt_p;       // identifies the value group
+  std::size_t   count;       // instances "of the same value" at the time of the event
+  std::size_t   batch;       // instances covered by this record: 1, or n for a bulk record (copy_n / destroy_n)
+  Symbol        name;        // empty for a moved-from instance
+  EventKind     kind;
+
+  static std::uint64_t now()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+};
+static_assert(sizeof(Event) <= 64, "Event should fit into one cache line");
+
+
+
+class EventSink
+/*
+  Receives drained events. Runs on the drainer thread (or the thread calling EventLog::flush()),
+  never on the thread that produced the events.
+ */
+{
+public:
+  virtual ~EventSink() {}
+  virtual void consume(const Event *ev, std::size_t n) = 0;
+  virtual void dropped(std::size_t /*n*/) {}
+  virtual void flush() {}
+};
+
+
+inline void write_all(int fd, const char *p, std::size_t n)   // write(2), continued after partial writes / EINTR
+{
+  while (n) {
+    const ssize_t w = ::write(fd, p, n);
+    if (w < 0) {
+      if (errno == EINTR)
+        continue;
+      return;   // (disk full, closed pipe etc.: the rest is lost, as with dropped events)
+    }
+    p += w;
+    n -= static_cast<std::size_t>(w);
+  }
+}
+
+
+class TextSink : public EventSink
+/*
+  Formats events in the classic human-readable format:
+    #constructor      cnt_p 0x... 	this 0x... 	name (1)
+
+  No ostream on the way: lines are formatted into a fixed buffer (std::to_chars, no locale, no allocation),
+  and a drained batch goes out with one write(2) to a file descriptor (default: stderr, unbuffered as std::cerr),
+  or with one ostream::write when constructed with an ostream.
+  Names longer than max_name are cut.
+ */
+{
+public:
+  static constexpr std::size_t max_name = 256;
+  static constexpr std::size_t max_line = 192 + max_name;   // (label, 2 pointers, 2 counts, bulk and same-value notes)
+
+  TextSink() : TextSink{STDERR_FILENO} {}
+  explicit TextSink(int fd_) : fd{fd_} {}
+  TextSink(std::ostream &os_) : os{&os_} {}
+
+  TextSink(const TextSink &) = delete;
+  TextSink &operator=(const TextSink &) = delete;
+
+  void consume(const Event *ev, std::size_t n) override
+  {
+    for (std::size_t i = 0; i < n; ++i) {
+      if (len + max_line > buf_size)
+        write_out();
+      len = static_cast<std::size_t>(format_event(buf + len, ev[i]) - buf);
+    }
+    write_out();
+  }
+
+  void dropped(std::size_t n) override
+  {
+    if (len + max_line > buf_size)
+      write_out();
+    char *p = put(buf + len, "#dropped          ");
+    p = put_dec(p, n);
+    p = put(p, " events (ring buffer full)\n");
+    len = static_cast<std::size_t>(p - buf);
+  }
+
+  void flush() override
+  {
+    write_out();
+    if (os)
+      os->flush();
+  }
+
+  static char *format_event(char *p, const Event &ev)   // writes at most max_line chars, returns the end
+  {
+    switch (ev.kind) {
+    case EventKind::constructor:      p = put(p, "#constructor      "); break;
+    case EventKind::copy_constructor: p = put(p, "#copy-constructor "); break;
+    case EventKind::move_constructor: p = put(p, "#move-constructor "); break;
+    case EventKind::move_assign:      p = put(p, "#move-assign      "); break;
+    case EventKind::assign:           [[fallthrough]];
+    case EventKind::assign_same:      p = put(p, "#operator=        "); break;
+    case EventKind::assign_result:    p = put(p, "\t ==>  ");          break;
+    case EventKind::destructor:       p = put(p, "#destructor       "); break;
+    case EventKind::detach:           p = put(p, "#detach           "); break;
+    }
+    p = format_info(p, ev);
+    switch (ev.kind) {
+    case EventKind::assign:      [[fallthrough]];
+    case EventKind::move_assign: return p;
+    case EventKind::assign_same: return put(p, "\t already_holding_same_value\n");
+    default:                     return put(p, "\n");
+    }
+  }
+
+  static char *format_info(char *p, const Event &ev)
+  {
+    p = put(p, "cnt_p ");
+    p = put_ptr(p, ev.cnt_p);
+    p = put(p, " \tthis ");
+    p = put_ptr(p, ev.obj);
+    p = put(p, " \t");
+    p = put(p, ev.name.view().substr(0, max_name));
+    p = put(p, " (");
+    p = put_dec(p, ev.count);
+    *p++ = ')';
+    if (ev.batch != 1) {
+      p = put(p, " \t[bulk: ");
+      p = put_dec(p, ev.batch);
+      p = put(p, " instances]");
+    }
+    return p;
+  }
+
+  static std::ostream &print_event(std::ostream &os, const Event &ev)
+  {
+    char line[max_line];
+    return os.write(line, format_event(line, ev) - line);
+  }
+
+  static std::ostream &print_info(std::ostream &os, const Event &ev)
+  {
+    char line[max_line];
+    return os.write(line, format_info(line, ev) - line);
+  }
+
+private:
+  static constexpr std::size_t buf_size = 64 * 1024;
+
+  static char *put(char *p, std::string_view s)
+  {
+    std::memcpy(p, s.data(), s.size());
+    return p + s.size();
+  }
+
+  static char *put_dec(char *p, std::uint64_t v) { return std::to_chars(p, p + 20, v).ptr; }
+
+  static char *put_ptr(char *p, const void *v)   // as ostream: 0x..., null: 0
+  {
+    if (v == nullptr) {
+      *p = '0';
+      return p + 1;
+    }
+    p[0] = '0';
+    p[1] = 'x';
+    return std::to_chars(p + 2, p + 18, reinterpret_cast<std::uintptr_t>(v), 16).ptr;
+  }
+
+  void write_out()
+  {
+    if (os)
+      os->write(buf, static_cast<std::streamsize>(len));
+    else
+      write_all(fd, buf, len);
+    len = 0;
+  }
+
+  int           fd = -1;
+  std::ostream *os = nullptr;
+  std::size_t   len = 0;
+  char          buf[buf_size];
+};
+
+
+
+class EventRing
+/*
+  Lock-free single-producer / single-consumer ring of Events.
+  Producer: the owning thread (push).     Consumer: whoever holds EventLog's drain lock (drain).
+
+  push() publishes n records all-or-nothing (so that assign / assign_result stay adjacent),
+  and drops (counting them) rather than block, if the ring is full.
+ */
+{
+public:
+  static constexpr std::size_t capacity = 1024;   // must be a power of 2
+  static_assert((capacity & (capacity - 1)) == 0, "capacity must be a power of 2");
+
+  bool push(const Event *ev, std::size_t n)
+  {
+    const std::size_t h = head.load(std::memory_order_relaxed);
+    if (h + n - tail_cache > capacity) {
+      tail_cache = tail.load(std::memory_order_acquire);
+      if (h + n - tail_cache > capacity) {
+        dropped_cnt.fetch_add(n, std::memory_order_relaxed);
+        return false;
+      }
+    }
+    for (std::size_t i = 0; i < n; ++i)
+      buf[(h + i) & (capacity - 1)] = ev[i];
+    head.store(h + n, std::memory_order_release);
+    return true;
+  }
+
+  template <typename F>   // F(const Event *ev, std::size_t n) -- called with up to 2 contiguous spans
+  std::size_t drain(F &&f)
+  {
+    const std::size_t t = tail.load(std::memory_order_relaxed);
+    const std::size_t h = head.load(std::memory_order_acquire);
+    if (h == t)
+      return 0;
+    const std::size_t first = t & (capacity - 1);
+    const std::size_t n     = h - t;
+    const std::size_t n1    = n < capacity - first ? n : capacity - first;
+    f(&buf[first], n1);
+    if (n1 < n)
+      f(&buf[0], n - n1);
+    tail.store(h, std::memory_order_release);
+    return n;
+  }
+
+  std::size_t take_dropped() { return dropped_cnt.exchange(0, std::memory_order_relaxed); }
+
+  std::atomic<bool> retired{false};   // set when the owning thread exits
+
+private:
+  alignas(64) std::atomic<std::size_t> head{0};
+  std::size_t                          tail_cache = 0;   // producer-private copy of tail
+  alignas(64) std::atomic<std::size_t> tail{0};
+  std::atomic<std::size_t>             dropped_cnt{0};
+  Event                                buf[capacity];
+};
+
+
+
+class EventLog
+/*
+  Collects Events from per-thread EventRings and hands them to the EventSinks
+  on a background drainer thread, so that formatting and I/O are off the hot path.
+
+  Hot path (EventLog::push): one copy of an Event (56 bytes) into the thread's ring and a release store.
+  Default sink: TextSink on stderr.
+  flush() drains synchronously (e.g. to interleave with other output on std::cerr).
+ */
+{
+public:
+  static EventLog &instance()
+  {
+    static EventLog log;
+    return log;
+  }
+
+  static void push(const Event *ev, std::size_t n = 1)
+  {
+    if (destroyed().load(std::memory_order_acquire)) {
+      // static destruction order: the log is no longer there -> synchronous fallback
+      for (std::size_t i = 0; i < n; ++i)
+        TextSink::print_event(std::cerr, ev[i]);
+      return;
+    }
+    if (EventRing *r = thread_ring()) {
+      r->push(ev, n);
+      return;
+    }
+    // thread exit, after this thread's ring was retired (e.g. a static or thread_local instance destroyed late):
+    // the late ring, shared by all such pushes (rare: producers serialized by a lock)
+    EventLog &log = instance();
+    std::lock_guard<std::mutex> lock{log.late_mtx};
+    if (log.late == nullptr)
+      log.late = log.register_ring();
+    log.late->push(ev, n);
+  }
+
+  void flush()
+  {
+    drain_all();
+    std::lock_guard<std::mutex> lock{drain_mtx};
+    for (auto &s : sinks)
+      s->flush();
+  }
+
+  void add_sink(std::shared_ptr<EventSink> sink)
+  {
+    std::lock_guard<std::mutex> lock{drain_mtx};
+    sinks.push_back(std::move(sink));
+  }
+
+  void clear_sinks()
+  {
+    std::lock_guard<std::mutex> lock{drain_mtx};
+    sinks.clear();
+  }
+
+  ~EventLog()
+  {
+    destroyed().store(true, std::memory_order_release);
+    {
+      std::lock_guard<std::mutex> lock{wake_mtx};
+      stop = true;
+    }
+    wake.notify_one();
+    drainer.join();
+    flush();
+  }
+
+private:
+  EventLog()
+    : sinks{std::make_shared<TextSink>()}
+  {
+    drainer = std::thread{[this] { run(); }};
+  }
+
+  static std::atomic<bool> &destroyed()
+  {
+    static std::atomic<bool> flag{false};
+    return flag;
+  }
+
+  struct ThreadRing {   // trivially destructible: still valid after RingHandle is destroyed
+    EventRing *ring   = nullptr;
+    bool       exited = false;
+  };
+
+  static ThreadRing &thread_state()
+  {
+    thread_local ThreadRing t;
+    return t;
+  }
+
+  struct RingHandle {   // retires the thread's ring at thread exit: the drainer frees it, no push may follow
+    ~RingHandle()
+    {
+      ThreadRing &t = thread_state();
+      t.ring->retired.store(true, std::memory_order_release);
+      t.ring   = nullptr;
+      t.exited = true;
+    }
+  };
+
+  static EventRing *thread_ring()   // null once the thread's ring is retired
+  {
+    ThreadRing &t = thread_state();
+    if (t.ring == nullptr && ! t.exited) {
+      t.ring = instance().register_ring();
+      thread_local RingHandle handle;
+      (void)handle;
+    }
+    return t.ring;
+  }
+
+  EventRing *register_ring()
+  {
+    std::lock_guard<std::mutex> lock{rings_mtx};
+    rings.emplace_back(new EventRing);
+    return rings.back().get();
+  }
+
+  std::size_t drain_all()
+  {
+    std::lock_guard<std::mutex> lock{drain_mtx};
+    std::vector<EventRing *> snapshot;
+    {
+      std::lock_guard<std::mutex> lock_rings{rings_mtx};
+      for (auto &r : rings)
+        snapshot.push_back(r.get());
+    }
+
+    std::size_t total = 0;
+    std::vector<EventRing *> done;
+    for (EventRing *r : snapshot) {
+      const bool retired = r->retired.load(std::memory_order_acquire);
+      total += r->drain([this](const Event *ev, std::size_t n) {
+          for (auto &s : sinks)
+            s->consume(ev, n);
+        });
+      if (const std::size_t d = r->take_dropped())
+        for (auto &s : sinks)
+          s->dropped(d);
+      if (retired)
+        done.push_back(r);
+    }
+
+    if (! done.empty()) {
+      std::lock_guard<std::mutex> lock_rings{rings_mtx};
+      for (EventRing *r : done)
+        for (auto it = rings.begin(); it != rings.end(); ++it)
+          if (it->get() == r) {
+            rings.erase(it);
+            break;
+          }
+    }
+    return total;
+  }
+
+  void run()
+  {
+    std::unique_lock<std::mutex> lock{wake_mtx};
+    while (! stop) {
+      lock.unlock();
+      const bool idle = drain_all() == 0;
+      if (idle)
+        flush();
+      lock.lock();
+      if (idle)
+        wake.wait_for(lock, std::chrono::milliseconds(1));
+    }
+  }
+
+  std::mutex                              rings_mtx;
+  std::vector<std::unique_ptr<EventRing>> rings;
+
+  std::mutex                              late_mtx;
+  EventRing                              *late = nullptr;   // never retired: freed with the log
+
+  std::mutex                              drain_mtx;   // serializes consumers and guards sinks
+  std::vector<std::shared_ptr<EventSink>> sinks;
+
+  std::mutex                              wake_mtx;
+  std::condition_variable                 wake;
+  bool                                    stop = false;
+  std::thread                             drainer;
+};
+
+#endif
@@ -0,0 +1,298 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include "symbol.h"
+
+/*
+  Log-bucket latency histograms (HDR style) of the lifecycle of monitored classes, see MonitorTimed (monitor.h).
+
+  LogHistogram        one histogram, written by a single thread (relaxed atomics: readable while written)
+  HistogramSnapshot   merged, plain copy of histograms, with count / mean / percentiles
+  Histograms          per thread and per name (Symbol): lifetime, constructor and destructor self-time [ns];
+  .                   merged() sums up all threads on demand
+ */
+
+struct HistogramBuckets {
+  // values 0..15 are exact; above, 8 buckets per power of 2 (relative error < 12.5%)
+  static constexpr unsigned    sub_bits  = 3;
+  static constexpr std::size_t sub       = std::size_t{1} << sub_bits;
+  static constexpr std::size_t n_buckets = (64 - sub_bits) * sub + sub;   // 496
+
+  static std::size_t index(std::uint64_t v)
+  {
+    if (v < 2 * sub)
+      return static_cast<std::size_t>(v);
+    const unsigned shift = 63U - static_cast<unsigned>(__builtin_clzll(v)) - sub_bits;
+    return shift * sub + static_cast<std::size_t>(v >> shift);
+  }
+
+  static std::uint64_t lower_bound(std::size_t i)
+  {
+    if (i < 2 * sub)
+      return i;
+    const std::size_t shift = i / sub - 1;
+    return static_cast<std::uint64_t>(i - shift * sub) << shift;
+  }
+};
+
+
+class LogHistogram
+/*
+  Single writer (the owning thread): record() is a few relaxed loads / stores, no read-modify-write.
+ */
+{
+public:
+  void record(std::uint64_t v)
+  {
+    bump(buckets[HistogramBuckets::index(v)], 1U);
+    bump(count, 1U);
+    bump(sum, v);
+    if (v > max.load(std::memory_order_relaxed))
+      max.store(v, std::memory_order_relaxed);
+  }
+
+private:
+  friend class HistogramSnapshot;
+
+  static void bump(std::atomic<std::uint64_t> &a, std::uint64_t d)
+  {
+    a.store(a.load(std::memory_order_relaxed) + d, std::memory_order_relaxed);
+  }
+
+  std::atomic<std::uint64_t> buckets[HistogramBuckets::n_buckets] = {};
+  std::atomic<std::uint64_t> count{0};
+  std::atomic<std::uint64_t> sum{0};
+  std::atomic<std::uint64_t> max{0};
+};
+
+
+class HistogramSnapshot {
+public:
+  void merge(const LogHistogram &h)
+  {
+    for (std::size_t i = 0; i < HistogramBuckets::n_buckets; ++i)
+      buckets[i] += h.buckets[i].load(std::memory_order_relaxed);
+    n    += h.count.load(std::memory_order_relaxed);
+    sum_ += h.sum.load(std::memory_order_relaxed);
+    max_  = std::max(max_, h.max.load(std::memory_order_relaxed));
+  }
+
+  void merge(const HistogramSnapshot &h)
+  {
+    for (std::size_t i = 0; i < HistogramBuckets::n_buckets; ++i)
+      buckets[i] += h.buckets[i];
+    n    += h.n;
+    sum_ += h.sum_;
+    max_  = std::max(max_, h.max_);
+  }
+
+  std::uint64_t count() const { return n; }
+  std::uint64_t max()   const { return max_; }
+  double        mean()  const { return n ? static_cast<double>(sum_) / static_cast<double>(n) : 0.0; }
+
+  std::uint64_t percentile(double p) const   // lower bound of the bucket holding the p-th percentile (0 <= p <= 100)
+  {
+    const std::uint64_t rank = static_cast<std::uint64_t>(p / 100.0 * static_cast<double>(n));
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < HistogramBuckets::n_buckets; ++i) {
+      seen += buckets[i];
+      if (seen > rank)
+        return HistogramBuckets::lower_bound(i);
+    }
+    return max_;
+  }
+
+  friend std::ostream &operator<<(std::ostream &os, const HistogramSnapshot &h)
+  {
+    return os << "n " << h.count() << " \tmean " << static_cast<std::uint64_t>(h.mean())
+              << " \tp50 " << h.percentile(50) << " \tp99 " << h.percentile(99) << " \tmax " << h.max();
+  }
+
+private:
+  std::uint64_t buckets[HistogramBuckets::n_buckets] = {};
+  std::uint64_t n    = 0;
+  std::uint64_t sum_ = 0;
+  std::uint64_t max_ = 0;
+};
+
+
+
+class Histograms
+/*
+  Per thread: one set of histograms per name, found by the name's dense id (two-level table, no lock).
+  A set is allocated once per thread and name, on first use; recording itself does not allocate.
+  At thread exit, a thread's histograms are folded into the totals of retired threads.
+  Instances destroyed later in that thread (e.g. static ones) are not recorded.
+ */
+{
+public:
+  struct Set {
+    LogHistogram lifetime;   // constructor .. destructor
+    LogHistogram ctor;       // self-time of the constructor
+    LogHistogram dtor;       // self-time of the destructor
+  };
+
+  struct Stats {
+    Symbol            name;
+    HistogramSnapshot lifetime;
+    HistogramSnapshot ctor;
+    HistogramSnapshot dtor;
+  };
+
+  static Set *local(Symbol name)   // nullptr: empty name, too many names, or after thread exit
+  {
+    Table *t = thread_table();
+    return t ? t->get(name) : nullptr;
+  }
+
+  static std::vector<Stats> merged()
+  {
+    Histograms &h = instance();
+    std::lock_guard<std::mutex> lock{h.mtx};
+    std::vector<Stats> res = h.retired;
+    for (const Table *t : h.tables)
+      t->merge_into(res);
+    return res;
+  }
+
+  static std::ostream &print(std::ostream &os)
+  {
+    for (const Stats &s : merged())
+      os << s.name << "\n  lifetime [ns]  " << s.lifetime
+                   << "\n  ctor     [ns]  " << s.ctor
+                   << "\n  dtor     [ns]  " << s.dtor << '\n';
+    return os;
+  }
+
+private:
+  static constexpr std::size_t chunk_size = 256;
+  static constexpr std::size_t n_chunks   = 64;   // up to 16384 names
+
+  struct Chunk {
+    std::atomic<Set *> sets[chunk_size] = {};
+    Symbol             names[chunk_size];   // written before the set is published
+  };
+
+  class Table {
+  public:
+    Table()
+    {
+      Histograms &h = instance();
+      std::lock_guard<std::mutex> lock{h.mtx};
+      h.tables.push_back(this);
+    }
+
+    ~Table()
+    {
+      Histograms &h = instance();
+      {
+        std::lock_guard<std::mutex> lock{h.mtx};
+        merge_into(h.retired);
+        h.tables.erase(std::find(h.tables.begin(), h.tables.end(), this));
+      }
+      for (auto &c : chunks)
+        if (Chunk *chunk = c.load(std::memory_order_relaxed)) {
+          for (auto &s : chunk->sets)
+            delete s.load(std::memory_order_relaxed);
+          delete chunk;
+        }
+    }
+
+    Set *get(Symbol name)
+    {
+      const std::uint32_t id = name.id();
+      if (id == 0 || id >= chunk_size * n_chunks)
+        return nullptr;
+      Chunk *chunk = chunks[id / chunk_size].load(std::memory_order_relaxed);
+      if (chunk == nullptr) {
+        chunk = new Chunk;
+        chunks[id / chunk_size].store(chunk, std::memory_order_release);
+      }
+      std::atomic<Set *> &slot = chunk->sets[id % chunk_size];
+      Set *s = slot.load(std::memory_order_relaxed);
+      if (s == nullptr) {
+        s = new Set;
+        chunk->names[id % chunk_size] = name;
+        slot.store(s, std::memory_order_release);
+      }
+      return s;
+    }
+
+    void merge_into(std::vector<Stats> &res) const   // (called with the Histograms mutex held)
+    {
+      for (std::size_t c = 0; c < n_chunks; ++c) {
+        const Chunk *chunk = chunks[c].load(std::memory_order_acquire);
+        if (chunk == nullptr)
+          continue;
+        for (std::size_t i = 0; i < chunk_size; ++i) {
+          const Set *s = chunk->sets[i].load(std::memory_order_acquire);
+          if (s == nullptr)
+            continue;
+          const Symbol name = chunk->names[i];
+          auto it = std::find_if(res.begin(), res.end(), [name](const Stats &st) { return st.name == name; });
+          if (it == res.end()) {
+            res.push_back(Stats{name, {}, {}, {}});
+            it = res.end() - 1;
+          }
+          it->lifetime.merge(s->lifetime);
+          it->ctor.merge(s->ctor);
+          it->dtor.merge(s->dtor);
+        }
+      }
+    }
+
+  private:
+    std::atomic<Chunk *> chunks[n_chunks] = {};
+  };
+
+  static Histograms &instance()
+  {
+    static Histograms *h = new Histograms;   // never destroyed: threads may exit during static destruction
+    return *h;
+  }
+
+  struct Local {   // trivially destructible: still valid after Handle is destroyed
+    Table *table  = nullptr;
+    bool   exited = false;
+  };
+
+  struct Handle {   // retires the thread's table at thread exit: no recording after that
+    ~Handle()
+    {
+      Local &l = tls();
+      delete l.table;
+      l.table  = nullptr;
+      l.exited = true;
+    }
+  };
+
+  static Local &tls()
+  {
+    thread_local Local l;
+    return l;
+  }
+
+  static Table *thread_table()   // null once the thread's table is retired
+  {
+    Local &l = tls();
+    if (l.table == nullptr && ! l.exited) {
+      l.table = new Table;
+      thread_local Handle handle;
+      (void)handle;
+    }
+    return l.table;
+  }
+
+  std::mutex          mtx;
+  std::vector<Table*> tables;    // of live threads
+  std::vector<Stats>  retired;   // merged histograms of exited threads
+};
+
+#endif
@@ -0,0 +1,148 @@
+#ifndef INTRUSIVE_H
+#define INTRUSIVE_H
+
+#include <cstddef>
+#include <new>
+#include <utility>
+
+#include "alloc.h"
+#include "cntpolicy.h"
+
+template <typename T>
+class IntrusivePtr;
+
+template <typename Derived, typename CntPolicy = CntPlain, typename Alloc = PoolAlloc>
+class IntrusiveRefCount {
+  /*
+    Intrusive Reference Counting (as boost::intrusive_ptr): the counter is a member of the object itself
+    (Derived derives from IntrusiveRefCount<Derived>), and a handle (IntrusivePtr<Derived>) is a single raw pointer.
+    No separate counter allocation and no pointer chase: the count shares the cache lines of the object's fields.
+
+    The object starts with count 1: the reference of whoever owns its memory.
+    .    IntrusivePtr<Derived>::make(args...)   heap (with Alloc): the reference is handed to the returned handle,
+    .                                           the last handle destroys the object
+    .    ArenaScope active                      the reference stays with the Arena (see alloc.h): handles never
+    .                                           destroy the object, the arena does (handles must not outlive it)
+    .    automatic storage (e.g. on the stack)  the reference stays with the scope: as above, memory "from the outside"
+
+    Copying an object gives the copy its own counter (count 1); assignment leaves both counts alone.
+    CntPolicy: CntPlain or CntAtomic (CntDeferred: decrements are applied immediately).
+    No virtual functions: make() allocates exactly a Derived, which is also what is destroyed.
+   */
+  static_assert(! CntPolicy::weak, "IntrusiveRefCount: no weak count (see CntWeak)");
+public:
+  using cnt_t = typename CntPolicy::cnt_t;
+
+  std::size_t use_count() const { return CntPolicy::load(cnt); }
+
+protected:
+  IntrusiveRefCount() noexcept                          { CntPolicy::init(cnt); }
+  IntrusiveRefCount(const IntrusiveRefCount &) noexcept { CntPolicy::init(cnt); }
+  IntrusiveRefCount &operator=(const IntrusiveRefCount &) noexcept { return *this; }
+  ~IntrusiveRefCount() = default;
+
+private:
+  template <typename> friend class IntrusivePtr;
+  using intrusive_t = IntrusiveRefCount;
+
+  template <typename... Args>
+  static Derived *create(Args&&... args)   // count 1: the reference of the returned pointer (heap), else: +1
+  {
+    if (Arena *arena = Arena::current()) {
+      Derived *obj = arena->make<Derived>(std::forward<Args>(args)...);
+      add_ref(*obj);
+      return obj;
+    }
+    void *mem = Alloc::allocate(sizeof(Derived), alignof(Derived));
+    try {
+      return new (mem) Derived(std::forward<Args>(args)...);
+    }
+    catch (...) {
+      Alloc::deallocate(mem, sizeof(Derived), alignof(Derived));
+      throw;
+    }
+  }
+
+  static void add_ref(const IntrusiveRefCount &r) { CntPolicy::inc(r.cnt); }
+
+  static void release(const IntrusiveRefCount &r)
+  {
+    if (CntPolicy::dec(r.cnt)) {
+      Derived *obj = const_cast<Derived *>(static_cast<const Derived *>(&r));
+      obj->~Derived();
+      Alloc::deallocate(obj, sizeof(Derived), alignof(Derived));
+    }
+  }
+
+  mutable cnt_t cnt;
+};
+
+
+
+template <typename T>
+class IntrusivePtr {
+  /*
+    Handle to an object of a class derived from IntrusiveRefCount (see above): a single raw pointer.
+    Copying / destroying a handle increments / decrements the object's own counter.
+    Move construction / move assignment transfer the reference: the moved-from handle is left null.
+   */
+  using intrusive_t = typename T::intrusive_t;
+public:
+  IntrusivePtr() noexcept : p{nullptr} {}
+
+  explicit IntrusivePtr(T *p_) noexcept   // an additional reference to an existing object (e.g. this)
+    : p{p_}
+  {
+    if (p)
+      intrusive_t::add_ref(*p);
+  }
+
+  template <typename... Args>
+  static IntrusivePtr make(Args&&... args)
+  {
+    IntrusivePtr h;
+    h.p = intrusive_t::create(std::forward<Args>(args)...);
+    return h;
+  }
+
+  IntrusivePtr(const IntrusivePtr &rhs) noexcept : IntrusivePtr{rhs.p} {}
+
+  IntrusivePtr(IntrusivePtr &&rhs) noexcept
+    : p{rhs.p}
+  {
+    rhs.p = nullptr;
+  }
+
+  IntrusivePtr &operator=(const IntrusivePtr &rhs) noexcept
+  {
+    IntrusivePtr tmp{rhs};
+    std::swap(p, tmp.p);
+    return *this;
+  }
+
+  IntrusivePtr &operator=(IntrusivePtr &&rhs) noexcept
+  {
+    IntrusivePtr tmp{std::move(rhs)};
+    std::swap(p, tmp.p);
+    return *this;
+  }
+
+  ~IntrusivePtr()
+  {
+    if (p)
+      intrusive_t::release(*p);
+  }
+
+  T *get()        const { return p; }
+  T &operator*()  const { return *p; }
+  T *operator->() const { return p; }
+
+  explicit operator bool() const { return p != nullptr; }
+
+  std::size_t use_count() const { return p ? p->use_count() : 0U; }
+
+private:
+  T *p;
+};
+
+#endif
@@ -1,21 +1,55 @@
 #include <iostream>
+#include <memory>
+#include <utility>
 
 #include "basewrapper.h"
+#include "tracefile.h"
+#include "chrometrace.h"
 
 class MyClass : public BaseWrapper {
 public:
   MyClass(const std::string &name = "MyClass") : BaseWrapper(name)
   {}
+  MyClass(const MyClass &rhs, bulk_t b) : BaseWrapper(rhs, b)   // for the bulk API
+  {}
 };
 
-#define CMD(cmd) std::cerr << #cmd << std::endl; cmd
+#define CMD(cmd) EventLog::instance().flush(); std::cerr << #cmd << std::endl; cmd
+
+static void print_live_groups()
+{
+  EventLog::instance().flush();
+  std::cerr << "live value groups: " << Registry::instance().live_groups()
+            << ", instances: "      << Registry::instance().live_instances() << std::endl;
+  for (const auto &e : Registry::instance().snapshot())
+    std::cerr << "  cnt_p " << e.cnt_p << " \t" << e.name << " (" << e.count << ')' << std::endl;
+}
 
-int main()
+int main(int argc, char *argv[])
 {
+  if (argc > 1)   // additionally write a binary trace (analyze with: trace-analyze <file>)
+    EventLog::instance().add_sink(std::make_shared<TraceSink>(argv[1]));
+  if (argc > 2)   // and a Chrome trace (JSON: open in ui.perfetto.dev or chrome://tracing)
+    EventLog::instance().add_sink(std::make_shared<ChromeTraceSink>(argv[2]));
+  Registry::enable();
+
   CMD(MyClass a{"a"});
   CMD(MyClass b{a});
   CMD(MyClass c{"c"});
   CMD(b = c);
   CMD(b = a);
+  CMD(MyClass d{std::move(c)});
+  CMD(b = std::move(d));
+
+  alignas(MyClass) unsigned char mem[4 * sizeof(MyClass)];
+  MyClass *arr = reinterpret_cast<MyClass *>(mem);
+  CMD(MyClass::copy_n(a, 4, arr));
+  print_live_groups();
+  CMD(MyClass::destroy_n(arr, 4));
+  print_live_groups();
+
+  CMD(MyClass e{a});
+  CMD(e.detach());
+  print_live_groups();
   return 0;
 }
@@ -0,0 +1,131 @@
+#ifndef MONITOR_H
+#define MONITOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "counters.h"
+#include "eventlog.h"
+#include "histogram.h"
+#include "registry.h"
+#include "sampling.h"
+
+/*
+  Monitor policies for BasicBaseWrapper.
+
+  MonitorOn   every lifecycle event of a sampled value group is recorded (see eventlog.h),
+  .           and fed to the live-object Registry (if enabled at runtime, see registry.h)
+  .           Sampling is configured at runtime (default: all groups, see sampling.h)
+  MonitorOff  all monitoring code is removed at compile time:
+  .           BasicBaseWrapper<..., MonitorOff> costs exactly what its RefCount base costs
+  MonitorTimed<Inner>   Inner (MonitorOn / MonitorOff), plus latency histograms per name (see histogram.h)
+  MonitorCounted<Inner> Inner, plus counters per name and event kind (see counters.h); with MonitorOff (default):
+  .                     no events at all, an event costs one uncontended increment
+
+  MonitorDefault (used by BaseWrapper) is selected with the macro BASEWRAPPER_MONITOR (0 / 1, default 1),
+  e.g. via the CMake option of the same name.
+ */
+
+struct MonitorOn {
+  static constexpr bool enabled = true;
+  static constexpr bool timed   = false;
+  static constexpr bool counted = false;
+
+  static bool sampled(const void *cnt_p, Symbol name) { return Sampling::sampled(cnt_p, name); }
+
+  static void record(const Event *ev, std::size_t n = 1)
+  {
+    track(ev, n);
+    log(ev, n);
+  }
+
+  // the two halves of record(): an assignment feeds the Registry with its old group before releasing it
+  // (its cnt_p may be reused right after), and logs the pair once complete
+  static void track(const Event *ev, std::size_t n = 1)
+  {
+    if (Registry::enabled())
+      Registry::instance().record(ev, n);
+  }
+
+  static void log(const Event *ev, std::size_t n = 1) { EventLog::push(ev, n); }
+};
+
+struct MonitorOff {
+  static constexpr bool enabled = false;
+  static constexpr bool timed   = false;
+  static constexpr bool counted = false;
+
+  static bool sampled(const void *, Symbol) { return false; }
+
+  static void record(const Event *, std::size_t = 1) {}
+  static void track(const Event *, std::size_t = 1)  {}
+  static void log(const Event *, std::size_t = 1)    {}
+};
+
+template <typename Inner = MonitorOn>
+class MonitorTimed : public Inner
+/*
+  Records, per name, the lifetime of each instance (end of constructor .. start of destructor), and the self-time
+  of its constructor / destructor (the RefCount part: counting, allocation / release) [ns].
+
+  Stateful (two words per instance): as the first base of BasicBaseWrapper, its constructor runs first
+  and its destructor last, so that it brackets the constructor / destructor of the RefCount base.
+  Moved-from (null) instances have no name: their destruction is not recorded.
+ */
+{
+public:
+  static constexpr bool timed = true;
+
+  MonitorTimed() : stamp{Event::now()} {}
+  MonitorTimed(const MonitorTimed &) : MonitorTimed{} {}   // a new instance: its own times
+  MonitorTimed &operator=(const MonitorTimed &) { return *this; }
+
+  ~MonitorTimed()
+  {
+    if (set)
+      set->dtor.record(Event::now() - stamp);
+  }
+
+protected:
+  void constructed(Symbol name)   // end of the constructor
+  {
+    const std::uint64_t now = Event::now();
+    if (Histograms::Set *s = Histograms::local(name))
+      s->ctor.record(now - stamp);
+    stamp = now;
+  }
+
+  void destroying(Symbol name)    // start of the destructor
+  {
+    const std::uint64_t now = Event::now();
+    if ((set = Histograms::local(name)))
+      set->lifetime.record(now - stamp);
+    stamp = now;
+  }
+
+private:
+  std::uint64_t    stamp;
+  Histograms::Set *set = nullptr;
+};
+
+template <typename Inner = MonitorOff>
+struct MonitorCounted : public Inner
+/*
+  Counts the lifecycle events per name and kind (all instances, not only sampled groups), in per-thread shards
+  (see EventCounters); CounterReporter prints the rates. Stateless.
+  The second half of an assignment (assign_result) is not counted, nor the new group of a detach.
+ */
+{
+  static constexpr bool counted = true;
+
+  static void count(Symbol name, EventKind kind, std::size_t n) { EventCounters::add(name, kind, n); }
+};
+
+#ifndef BASEWRAPPER_MONITOR
+#define BASEWRAPPER_MONITOR 1
+#endif
+
+using MonitorDefault = std::conditional_t<BASEWRAPPER_MONITOR, MonitorOn, MonitorOff>;
+
+#endif
@@ -1,65 +1,334 @@
 #ifndef REFCOUNT_H
 #define REFCOUNT_H
 
+#include <cstddef>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+
 #include "stackheapptr.h"
+#include "cntpolicy.h"
+#include "ctrlblock.h"
+
+template <typename T>
+struct inline_value
+/*
+  Trait: store T inline in each RefCount instance (instead of behind a StackheapPtr).
+  Default: trivially copyable T up to the size of a pointer. Specialize to opt in / out.
+ */
+  : std::integral_constant<bool, std::is_trivially_copyable<T>::value && sizeof(T) <= sizeof(void *)>
+{
+};
+
+template <typename T>
+struct copy_on_write
+/*
+  Trait: copy-on-write mode for RefCount<T>: get_data() is const-only, and the only mutable access is
+  get_mutable(), which detaches first (see RefCount). Default: off (get_data() gives shared, mutable access).
+ */
+  : std::false_type
+{
+};
+
+template <typename T>
+class InlineValue
+/*
+  Data storage of RefCount for inline_value<T>: every instance holds its own copy of the value,
+  which is never modified (so all instances "of the same value" still agree).
+  Same interface as the parts of StackheapPtr that RefCount uses.
+ */
+{
+public:
+  explicit InlineValue(const T &v = T{}) : value{v} {}
+  static InlineValue null() { return InlineValue{}; }
+
+  const T &operator*() const { return value; }
+  T       &operator*()       { return value; }   // (get_mutable only: after detach, this instance is alone)
 
-template<typename T>
+  bool on_heap() const { return false; }
+  void delete1()       {}
+
+private:
+  T value;
+};
+
+
+
+template <typename T, typename CntPolicy, typename Alloc>
+class WeakRef;
+
+template<typename T, typename CntPolicy = CntPlain, typename Alloc = PoolAlloc>
 class RefCount {
+  /*
+    Reference Counting of instances "of the same value" (due to: copy construction, copy assignment),
+    which share the counter and the data.
+
+    Move construction / move assignment transfer the instance: the count does not change,
+    and the moved-from instance is left null (it may only be destroyed, or assigned to).
+
+    Constructor takes a value of the data to hold, and then 2 pointers (one to hold copy of data, one to hold counter)
+    If both pointers are nullptr, counter and data are allocated together in one ControlBlock on the heap (with Alloc);
+    if only one is nullptr, that one is allocated on its own;
+    else memory is passed in from outside [typically from stack].
+    (heap allocations are drawn from the Arena instead, while an ArenaScope is active -- see alloc.h)
+
+    Small values (inline_value<T>, e.g. int or Symbol) are stored inline in each instance instead:
+    get_data() needs no indirection, only the counter is allocated (dat_ptr is not used),
+    and get_data() is const-only, since instances no longer share the memory of the value.
+
+    Copy-on-write: get_mutable() first detaches a shared instance (detach(): the instance gets a new value group,
+    with a copy of the value; the old group loses one instance), so that writes never alias other instances.
+    Reads stay shared. copy_on_write<T> makes this the only mutable access (get_data() const-only).
+
+    Weak references (CntPolicy CntWeak, see weakref.h): when the last instance is gone, the value is destroyed,
+    but the counter (with a ControlBlock: the whole block) is only released once the last WeakRef is gone.
+    Memory from the outside stays the caller's: it must outlive the instances and the WeakRefs.
+
+    Bulk API, for arrays: copy_n / destroy_n handle n instances "of the same value" with one counter update.
+   */
 public:
-  using cnt_t = size_t;
-  RefCount(const T &dat = T{}, T * dat_ptr = nullptr, cnt_t *cnt = nullptr) :
-    cnt_p{cnt}, data{dat_ptr}
+  using cnt_t  = typename CntPolicy::cnt_t;
+  using data_t = T;
+  static constexpr bool inline_data = inline_value<T>::value;
+
+  RefCount(const T &dat = T{}, T * dat_ptr = nullptr, cnt_t *cnt = nullptr)
+    : RefCount(create_block(dat, dat_ptr, cnt), dat, dat_ptr, cnt)
   {
-    *cnt_p = 1U;
-    *data  = dat;
   }
   
   RefCount(const RefCount &rhs)
-    : data{rhs.data}, cnt_p{rhs.cnt_p}
+    : cnt_p{rhs.cnt_p}, data{rhs.data}
   {
-    ++*cnt_p;
+    if (cnt_p)
+      CntPolicy::inc(*cnt_p);
   }
 
-  RefCount<T> &operator=(const RefCount<T> &rhs);
+  RefCount(RefCount &&rhs) noexcept
+    : cnt_p{std::move(rhs.cnt_p)}, data{std::move(rhs.data)}
+  {
+  }
+
+  RefCount &operator=(const RefCount &rhs);
+  RefCount &operator=(RefCount &&rhs) noexcept;
   
-  virtual ~RefCount()
+  ~RefCount()
   {
     decrease_cnt_check_del();
   }
 
-  const cnt_t *get_shared_cnt_ptr() const { return &*cnt_p;}
+  const cnt_t *get_shared_cnt_ptr() const { return cnt_p.get(); }
+  std::size_t  use_count()          const { return cnt_p ? CntPolicy::load(*cnt_p) : 0U; }
   const T &get_data() const { return *data; }
-  T       &get_data()       { return *data; }
+  std::conditional_t<inline_data || copy_on_write<T>::value, const T &, T &> get_data() { return *data; }
+
+  // copy-on-write: if shared, makes this the only instance of a new value group (copy of the value); true if detached
+  bool detach() { return detach_impl([] {}); }
+  T   &get_mutable() { detach(); return *data; }
+
+  // constructs n copies of src in the uninitialized storage dst[0..n)                (counter: +n)
+  static void copy_n(const RefCount &src, std::size_t n, RefCount *dst)  { copy_n_impl(src, n, dst); }
+  // destroys p[0..n); consecutive instances of the same value are released together  (counter: -run)
+  static void destroy_n(RefCount *p, std::size_t n)                      { destroy_n_impl(p, n, [](RefCount *, std::size_t) {}); }
 
 protected:
-  StackheapPtr<cnt_t> cnt_p;
-  StackheapPtr<T>     data;
+  using data_ptr_t = std::conditional_t<inline_data, InlineValue<T>, StackheapPtr<T, Alloc>>;
+
+  StackheapPtr<cnt_t, Alloc> cnt_p;
+  data_ptr_t                 data;
+
+  class bulk_t {   // tag of the uncounted copy below: only RefCount creates one (copy_n_impl)
+    friend class RefCount;
+    explicit bulk_t() = default;
+  };
+
+  // copy, without touching the counter (see copy_n_impl)
+  RefCount(const RefCount &rhs, bulk_t) noexcept
+    : cnt_p{rhs.cnt_p}, data{rhs.data}
+  {
+  }
+
+  template <typename R>   // R: RefCount, or derived from it and constructible from (const R &, bulk_t)
+  static void copy_n_impl(const R &src, std::size_t n, R *dst)
+  {
+    for (std::size_t i = 0; i < n; ++i)
+      new (&dst[i]) R(src, bulk_t{});
+    if (n == 0)
+      return;
+    RefCount &first = dst[0];
+    if (first.cnt_p)
+      CntPolicy::add(*first.cnt_p, n);
+  }
+
+  // detach(), calling on_split() right before the old value group is released (only if this does detach)
+  template <typename F>
+  bool detach_impl(F &&on_split);
+
+  // on_run(first, k) is called before a run of k instances of the same value is released.
+  // Released instances are left null, and their storage is simply reused afterwards (R must not add state
+  // that needs destruction): the destructor of a null instance would do nothing but (for BasicBaseWrapper) log.
+  template <typename R, typename F>
+  static void destroy_n_impl(R *p, std::size_t n, F &&on_run)
+  {
+    for (std::size_t i = 0; i < n; ) {
+      std::size_t j = i + 1;
+      while (j < n && p[j].get_shared_cnt_ptr() == p[i].get_shared_cnt_ptr())
+        ++j;
+      on_run(&p[i], j - i);
+      static_cast<RefCount &>(p[i]).decrease_cnt_check_del(j - i);
+      for (; i < j; ++i)
+        static_cast<RefCount &>(p[i]).forget();
+    }
+  }
 
   
 private:
-   void decrease_cnt_check_del();
+  friend class WeakRef<T, CntPolicy, Alloc>;
+  using block_t = ControlBlock<cnt_t, T, Alloc>;
+
+  // instance of the value group of a WeakRef, if the group is still alive (else left null)
+  RefCount(const StackheapPtr<cnt_t, Alloc> &c, const data_ptr_t &d) noexcept
+    : cnt_p{c}, data{d}
+  {
+    if (! (cnt_p && CntPolicy::inc_not_zero(*cnt_p)))
+      forget();
+  }
+
+  // one weak reference less (CntWeak); the last one releases the counter (with a ControlBlock: the block)
+  static void weak_release(StackheapPtr<cnt_t, Alloc> &c, data_ptr_t &d)
+  {
+    if (! CntPolicy::weak_dec(*c))
+      return;
+    if (c.on_heap() && d.on_heap())
+      block_t::deallocate(&*c);
+    else
+      c.delete1();
+  }
+
+  RefCount(typename block_t::Created block, const T &dat, T *dat_ptr, cnt_t *cnt)
+    : cnt_p{block.cnt ? init_ptr(block.cnt, block.on_heap) : StackheapPtr<cnt_t, Alloc>{cnt}},
+      data {init_data(block, dat, dat_ptr)}
+  {
+    CntPolicy::init(*cnt_p);
+    if constexpr (! inline_data)
+      if (block.cnt == nullptr)
+        *data = dat;
+  }
+
+  static typename block_t::Created create_block(const T &dat, T *dat_ptr, cnt_t *cnt)
+  {
+    if constexpr (inline_data)
+      return {};   // only the counter is allocated (by StackheapPtr)
+    else
+      return (dat_ptr == nullptr && cnt == nullptr) ? block_t::create(dat) : typename block_t::Created{};
+  }
+
+  static data_ptr_t init_data(typename block_t::Created block, const T &dat, T *dat_ptr)
+  {
+    if constexpr (inline_data)
+      return data_ptr_t{dat};
+    else
+      return block.cnt ? init_ptr(block_t::data(block.cnt), block.on_heap) : data_ptr_t{dat_ptr};
+  }
+
+  template <typename U>
+  static StackheapPtr<U, Alloc> init_ptr(U *p, bool on_heap)
+  {
+    return on_heap ? StackheapPtr<U, Alloc>::adopt(p) : StackheapPtr<U, Alloc>{p};
+  }
+
+  void forget() noexcept   // leaves this null, without touching the counter
+  {
+    StackheapPtr<cnt_t, Alloc> c{std::move(cnt_p)};
+    data_ptr_t                 d{std::move(data)};
+  }
+
+   void decrease_cnt_check_del(std::size_t n = 1);
 };
 
-template <typename T>
-RefCount<T> &RefCount<T>::operator=(const RefCount<T> &rhs)
+template <typename T, typename CntPolicy, typename Alloc>
+RefCount<T, CntPolicy, Alloc> &RefCount<T, CntPolicy, Alloc>::operator=(const RefCount &rhs)
 {
    if (get_shared_cnt_ptr() == rhs.get_shared_cnt_ptr())
       return *this;
 
-   data = rhs.data;
    decrease_cnt_check_del();
+   data  = rhs.data;
    cnt_p = rhs.cnt_p;
-   ++*cnt_p;
+   if (cnt_p)
+      CntPolicy::inc(*cnt_p);
 
    return *this;
 }
 
-template <typename T>
-void RefCount<T>::decrease_cnt_check_del() {
-   if (--*cnt_p == 0) {
+template <typename T, typename CntPolicy, typename Alloc>
+RefCount<T, CntPolicy, Alloc> &RefCount<T, CntPolicy, Alloc>::operator=(RefCount &&rhs) noexcept
+{
+   if (this == &rhs)
+      return *this;
+
+   // if rhs holds the same value, this cannot drop the count to 0 (rhs's instance is taken over)
+   decrease_cnt_check_del();
+   data  = std::move(rhs.data);
+   cnt_p = std::move(rhs.cnt_p);
+
+   return *this;
+}
+
+template <typename T, typename CntPolicy, typename Alloc>
+template <typename F>
+bool RefCount<T, CntPolicy, Alloc>::detach_impl(F &&on_split)
+{
+   if (! cnt_p || CntPolicy::load(*cnt_p) == 1)
+      return false;   // (CntDeferred: load() is an upper bound -- at worst, an unnecessary copy)
+
+   RefCount fresh{*data};
+   on_split();
+   *this = std::move(fresh);
+   return true;
+}
+
+template <typename T, typename CntPolicy, typename Alloc>
+void RefCount<T, CntPolicy, Alloc>::decrease_cnt_check_del(std::size_t n) {
+   if constexpr (CntPolicy::weak) {
+      if (cnt_p && (n == 1 ? CntPolicy::dec(*cnt_p) : CntPolicy::sub(*cnt_p, n))) {
+         // the value now, the counter once no WeakRef is left
+         if (cnt_p.on_heap() && data.on_heap())
+            block_t::destroy_data(&*cnt_p);
+         else
+            data.delete1();
+         weak_release(cnt_p, data);
+      }
+      return;
+   }
+   else if constexpr (CntPolicy::deferred && inline_data) {
+      if (cnt_p && cnt_p.on_heap()) {
+         // only the counter is on the heap
+         CntPolicy::defer(*cnt_p, n, [](void *cnt) { StackheapPtr<cnt_t, Alloc>::adopt(static_cast<cnt_t *>(cnt)).delete1(); });
+         return;
+      }
+   }
+   else if constexpr (CntPolicy::deferred) {
+      if (cnt_p && cnt_p.on_heap() && data.on_heap()) {
+         // ControlBlock: released by the address of its counter alone, so the decrement may be buffered
+         CntPolicy::defer(*cnt_p, n, [](void *cnt) { block_t::destroy(static_cast<cnt_t *>(cnt)); });
+         return;
+      }
+   }
+   if (cnt_p && (n == 1 ? CntPolicy::dec(*cnt_p) : CntPolicy::sub(*cnt_p, n))) {
+      if (cnt_p.on_heap() && data.on_heap()) {
+         // both on the heap: always allocated together as ControlBlock
+         block_t::destroy(&*cnt_p);
+         return;
+      }
       data.delete1();
       cnt_p.delete1();
    }
 }
 
+static_assert(sizeof(RefCount<long>) == sizeof(StackheapPtr<CntPlain::cnt_t>) + sizeof(long),
+              "RefCount of a small value must consist of nothing but its counter pointer and the value (no vptr)");
+static_assert(sizeof(RefCount<std::string>) == sizeof(StackheapPtr<CntPlain::cnt_t>) + sizeof(StackheapPtr<std::string>),
+              "RefCount must consist of nothing but its two pointers (no vptr)");
+
 #endif
@@ -1,19 +1,35 @@
 #ifndef REFCOUNTONLY_H
 #define REFCOUNTONLY_H
 
+#include <utility>
+
+#include "stackheapptr.h"
+#include "cntpolicy.h"
+
+template <typename CntPolicy = CntPlain>
 class RefCountOnly {
+  /*
+    Reference Counting only (no shared data), see RefCount.
+    No virtual functions: derived classes are not to be deleted through a pointer to RefCountOnly.
+   */
 public:
-  using cnt_t = size_t;
+  using cnt_t = typename CntPolicy::cnt_t;
   RefCountOnly(cnt_t *cnt = nullptr) :
     cnt_p{cnt}
   {
-    *cnt_p = 1U;
+    CntPolicy::init(*cnt_p);
   }
   
   RefCountOnly(const RefCountOnly &rhs)
     : cnt_p{rhs.cnt_p}
   {
-    ++*cnt_p;
+    if (cnt_p)
+      CntPolicy::inc(*cnt_p);
+  }
+
+  RefCountOnly(RefCountOnly &&rhs) noexcept   // rhs is left null
+    : cnt_p{std::move(rhs.cnt_p)}
+  {
   }
 
   RefCountOnly &operator=(const RefCountOnly &rhs)
@@ -23,24 +39,37 @@ public:
 
     decrease_cnt_check_del();
     cnt_p = rhs.cnt_p;
-    ++*cnt_p;
+    if (cnt_p)
+      CntPolicy::inc(*cnt_p);
+
+    return *this;
+  }
+
+  RefCountOnly &operator=(RefCountOnly &&rhs) noexcept   // rhs is left null
+  {
+    if (this == &rhs)
+      return *this;
+
+    decrease_cnt_check_del();
+    cnt_p = std::move(rhs.cnt_p);
 
     return *this;
   }
   
-  virtual ~RefCountOnly()
+  ~RefCountOnly()
   {
     decrease_cnt_check_del();
   }
 
-  const cnt_t *get_shared_cnt_ptr() const { return &*cnt_p;}
+  const cnt_t *get_shared_cnt_ptr() const { return cnt_p.get(); }
+  std::size_t  use_count()          const { return cnt_p ? CntPolicy::load(*cnt_p) : 0U; }
 
 protected:
   StackheapPtr<cnt_t> cnt_p;
   
 private:
   void decrease_cnt_check_del() {
-    if (--*cnt_p == 0) {
+    if (cnt_p && CntPolicy::dec(*cnt_p)) {
       cnt_p.delete1();
     }
   }
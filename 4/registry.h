@@ -0,0 +1,134 @@
+#ifndef REGISTRY_H
+#define REGISTRY_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "eventlog.h"
+
+class Registry
+/*
+  Global registry of live value groups (values with at least one instance), e.g. for finding leaks.
+
+  Each group (identified by cnt_p) is tracked with its name, its number of instances and its creation time.
+  The registry is fed from the lifecycle events on the thread that produces them (see MonitorOn),
+  and keeps its own count of instances -- so that snapshot() never touches the memory of a group.
+
+  Sharded by cnt_p: an update only locks the shard of its group, so different value groups do not contend.
+  live_groups() / live_instances() are O(1), snapshot() copies all entries (locking one shard at a time).
+
+  Disabled by default: when disabled, the cost per event is one relaxed load and a branch.
+ */
+{
+public:
+  struct Entry {
+    const void   *cnt_p;
+    Symbol        name;
+    std::size_t   count;     // live instances "of the same value"
+    std::uint64_t created;   // steady_clock [ns]
+  };
+
+  static Registry &instance()
+  {
+    static Registry *reg = new Registry;   // never destroyed: instances may be destroyed during static destruction
+    return *reg;
+  }
+
+  static bool enabled()             { return instance().on.load(std::memory_order_relaxed); }
+  static void enable(bool e = true) { instance().on.store(e, std::memory_order_relaxed); }
+
+  void record(const Event *ev, std::size_t n)
+  {
+    for (std::size_t i = 0; i < n; ++i) {
+      const Event &e = ev[i];   // (cnt_p == nullptr: moved-from instance, never found in the registry)
+      switch (e.kind) {
+      case EventKind::constructor:      add(e);               break;
+      case EventKind::copy_constructor: update(e.cnt_p, +static_cast<std::ptrdiff_t>(e.batch)); break;
+      case EventKind::assign_result:    update(e.cnt_p, +1); break;
+      case EventKind::move_assign:      ++i;                  // rhs's instance is taken over: the new value does not change
+                                        [[fallthrough]];      // (this drops its old value)
+      case EventKind::assign:           update(e.cnt_p, -1); break;
+      case EventKind::detach:           update(e.cnt_p, -1); break;
+      case EventKind::destructor:       update(e.cnt_p, -static_cast<std::ptrdiff_t>(e.batch)); break;
+      default:                                               break;
+      }
+    }
+  }
+
+  std::size_t live_groups()    const { return n_groups.load(std::memory_order_relaxed); }
+  std::size_t live_instances() const { return n_instances.load(std::memory_order_relaxed); }
+
+  std::vector<Entry> snapshot() const
+  {
+    std::vector<Entry> res;
+    res.reserve(live_groups());
+    for (const Shard &s : shards) {
+      std::lock_guard<std::mutex> lock{s.mtx};
+      for (const auto &kv : s.groups)
+        res.push_back(kv.second);
+    }
+    return res;
+  }
+
+private:
+  static constexpr std::size_t n_shards = 64;
+
+  struct alignas(64) Shard {
+    mutable std::mutex                           mtx;
+    std::unordered_map<const void *, Entry>      groups;
+  };
+
+  Registry() {}
+
+  Shard &shard(const void *cnt_p)
+  {
+    const std::uintptr_t a = reinterpret_cast<std::uintptr_t>(cnt_p) >> 4;
+    return shards[(a * 0x9E3779B97F4A7C15ULL) >> 58];   // top 6 bits: n_shards == 64
+  }
+
+  void add(const Event &e)
+  {
+    Shard &s = shard(e.cnt_p);
+    std::size_t stale;   // instances of an entry still there (its group's end was missed): replaced
+    {
+      std::lock_guard<std::mutex> lock{s.mtx};
+      Entry &entry = s.groups[e.cnt_p];
+      stale = entry.count;
+      entry = Entry{e.cnt_p, e.name, 1U, e.timestamp};
+    }
+    if (stale == 0)
+      n_groups.fetch_add(1, std::memory_order_relaxed);
+    n_instances.fetch_add(1 - stale, std::memory_order_relaxed);
+  }
+
+  void update(const void *cnt_p, std::ptrdiff_t delta)
+  {
+    Shard &s = shard(cnt_p);
+    bool removed = false;
+    {
+      std::lock_guard<std::mutex> lock{s.mtx};
+      auto it = s.groups.find(cnt_p);
+      if (it == s.groups.end())
+        return;   // moved-from instance, or group created while the registry was disabled
+      it->second.count += delta;
+      if (it->second.count == 0) {
+        s.groups.erase(it);
+        removed = true;
+      }
+    }
+    n_instances.fetch_add(static_cast<std::size_t>(delta), std::memory_order_relaxed);
+    if (removed)
+      n_groups.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  std::atomic<bool>        on{false};
+  std::atomic<std::size_t> n_groups{0};
+  std::atomic<std::size_t> n_instances{0};
+  Shard                    shards[n_shards];
+};
+
+#endif
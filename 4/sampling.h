@@ -0,0 +1,62 @@
+#ifndef SAMPLING_H
+#define SAMPLING_H
+
+#include <atomic>
+#include <cstdint>
+
+#include "symbol.h"
+
+class Sampling
+/*
+  Runtime sampling of value groups for MonitorOn: trace 1 in n value groups.
+
+  A group is chosen by hashing its cnt_p, so the decision is the same for all of its events
+  (constructor, copies, assignments, destructors): traced chains stay coherent.
+  The rate is set per class (i.e. per name, see symbol.h), else the default rate applies.
+  .    rate 1: trace all groups (default)      rate 0: trace none
+  Moved-from (null) instances belong to no group: they are only traced at the default rate 1.
+
+  Cost for an unsampled group: two relaxed loads, a multiply and a (predictable) branch.
+ */
+{
+public:
+  static void set_rate(std::uint32_t n)                 { default_threshold().store(threshold(n), std::memory_order_relaxed); }
+  static void set_rate(Symbol name, std::uint32_t n)    { store(name, threshold(n)); }
+  static void reset_rate(Symbol name)                   { store(name, inherit); }   // back to the default rate
+
+  static bool sampled(const void *cnt_p, Symbol name)
+  {
+    const SymbolEntry *e = name.get_entry();
+    std::uint64_t t = e ? e->sample_threshold.load(std::memory_order_relaxed) : inherit;
+    if (t == inherit)
+      t = default_threshold().load(std::memory_order_relaxed);
+    if (cnt_p == nullptr)
+      return t == all;
+    return hash(cnt_p) < t;
+  }
+
+private:
+  static constexpr std::uint64_t all     = std::uint64_t{1} << 63;   // hash() < all, always
+  static constexpr std::uint64_t inherit = ~std::uint64_t{0};
+
+  static constexpr std::uint64_t threshold(std::uint32_t n) { return n ? all / n : 0U; }
+
+  static std::uint64_t hash(const void *cnt_p)   // 63 bits
+  {
+    return ((reinterpret_cast<std::uintptr_t>(cnt_p) >> 3) * 0x9E3779B97F4A7C15ULL) >> 1;
+  }
+
+  static void store(Symbol name, std::uint64_t t)
+  {
+    if (const SymbolEntry *e = name.get_entry())   // (the empty name always uses the default rate)
+      e->sample_threshold.store(t, std::memory_order_relaxed);
+  }
+
+  static std::atomic<std::uint64_t> &default_threshold()
+  {
+    static std::atomic<std::uint64_t> t{all};
+    return t;
+  }
+};
+
+#endif
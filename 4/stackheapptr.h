@@ -1,17 +1,71 @@
 #ifndef STACKHEAPPTR_H
 #define STACKHEAPPTR_H
 
+#include <cstdint>
+
+#include "alloc.h"
+
+template <typename T, bool tagged = (alignof(T) >= 2)>
+class StackheapPtrRep
+/*
+  Representation of StackheapPtr: pointer + is_heap flag, in a single word.
+  The flag is stored in the pointer's lowest bit, which is always 0 for a T aligned to 2 or more.
+ */
+{
+public:
+  static_assert(alignof(T) >= 2, "the low bit of the pointer must be free");
+
+  StackheapPtrRep(T *p = nullptr, bool is_heap = false)
+    : bits{reinterpret_cast<std::uintptr_t>(p) | static_cast<std::uintptr_t>(is_heap)}
+  {
+  }
+
+  T   *ptr()     const { return reinterpret_cast<T *>(bits & ~std::uintptr_t{1}); }
+  bool is_heap() const { return bits & std::uintptr_t{1}; }
+
+private:
+  std::uintptr_t bits;
+};
+
 template <typename T>
+class StackheapPtrRep<T, false>
+/*
+  Fallback for T aligned to 1 (no free bit): separate flag.
+ */
+{
+public:
+  StackheapPtrRep(T *p = nullptr, bool is_heap_ = false)
+    : p_{p}, heap_{is_heap_}
+  {
+  }
+
+  T   *ptr()     const { return p_; }
+  bool is_heap() const { return heap_; }
+
+private:
+  T   *p_;
+  bool heap_;
+};
+
+
+
+template <typename T, typename Alloc = PoolAlloc>
 class StackheapPtr
 /*
   Class that is just as unsafe as a normal pointer, 
   meaning that you must not forget to call delete (if the class was default-initialized [with nullptr]).
   
   But!!!
-  The pointer can refer to memory on the heap (allocated with new) -- this is if it was default-initialized [with nullptr]
+  The pointer can refer to memory on the heap (allocated with Alloc) -- this is if it was default-initialized [with nullptr]
   .      -> in this case delete1() will delete
   Or  the pointer can refer to memory passed in from the outside (typically on the stack)
   .      -> in this case delete1() will not delete (since the memory then has to be handled from the outside)
+  Or  the pointer can refer to heap memory allocated elsewhere, whose ownership was handed over with adopt()
+
+  If default-initialized while an ArenaScope is active, the memory is drawn from that Arena
+  and counts as memory from the outside (the arena releases it).
+
+  Single word (for alignof(T) >= 2): the is_heap flag is packed into the pointer (see StackheapPtrRep).
  */
 {
 public:
@@ -19,50 +73,86 @@ public:
 
   StackheapPtr(T *p = nullptr);
 
-  StackheapPtr(const StackheapPtr<T> &rhs)
-    : ptr{rhs.ptr}, is_heap{rhs.is_heap}
+  static StackheapPtr adopt(T *p)
+  {
+    return StackheapPtr{rep_t{p, p != nullptr}};   // (null: not on the heap, nothing to delete)
+  }
+
+  static StackheapPtr null() noexcept   // (without allocating, unlike StackheapPtr{nullptr})
+  {
+    return StackheapPtr{rep_t{}};
+  }
+
+  StackheapPtr(const StackheapPtr &rhs) = default;
+
+  StackheapPtr(StackheapPtr &&rhs) noexcept   // rhs is left null
+    : rep{rhs.rep}
   {
+    rhs.rep = rep_t{};
   }
   
-  StackheapPtr<T> &operator=(const StackheapPtr<T> &rhs);
+  StackheapPtr &operator=(const StackheapPtr &rhs) = default;
 
-  virtual ~StackheapPtr()
+  StackheapPtr &operator=(StackheapPtr &&rhs) noexcept   // rhs is left null
   {
+    rep     = rhs.rep;
+    rhs.rep = rep_t{};
+    return *this;
   }
 
   void delete1()
   {
-    if (is_heap)
-      delete ptr;
+    if (rep.is_heap()) {
+      T *ptr = rep.ptr();
+      ptr->~T();
+      Alloc::deallocate(ptr, sizeof(T), alignof(T));
+    }
   }
   
-  T       &operator*()       { return *ptr; }
-  const T &operator*() const { return *ptr; }
+  T       &operator*()       { return *rep.ptr(); }
+  const T &operator*() const { return *rep.ptr(); }
 
-  T       *operator->()       { return ptr; }
-  const T *operator->() const { return ptr; }
+  T       *operator->()       { return rep.ptr(); }
+  const T *operator->() const { return rep.ptr(); }
+
+  T       *get()       { return rep.ptr(); }
+  const T *get() const { return rep.ptr(); }
+
+  explicit operator bool() const { return rep.ptr() != nullptr; }
+
+  bool on_heap() const { return rep.is_heap(); }
 
 private:
-  T   *ptr;
-  bool is_heap;
+  using rep_t = StackheapPtrRep<T>;
+
+  explicit StackheapPtr(rep_t r) noexcept
+    : rep{r}
+  {
+  }
+
+  rep_t rep;
 };
 
-template <typename T>
-StackheapPtr<T>::StackheapPtr(T *p)
-  : ptr{p}, is_heap{false}
+template <typename T, typename Alloc>
+StackheapPtr<T, Alloc>::StackheapPtr(T *p)
+  : rep{p}
 {
-   if (ptr == nullptr) {
-      ptr = new T{};
-      is_heap = true;
+   if (p == nullptr) {
+      if (Arena *arena = Arena::current()) {
+         rep = rep_t{arena->make<T>()};
+         return;
+      }
+      void *mem = Alloc::allocate(sizeof(T), alignof(T));
+      try {
+         rep = rep_t{new (mem) T{}, true};
+      }
+      catch (...) {
+         Alloc::deallocate(mem, sizeof(T), alignof(T));
+         throw;
+      }
    }
 }
 
-template <typename T>
-StackheapPtr<T> &StackheapPtr<T>::operator=(const StackheapPtr<T> &rhs)
-{
-   ptr     = rhs.ptr;
-   is_heap = rhs.is_heap;
-   return *this;
-}
+static_assert(sizeof(StackheapPtr<std::size_t>) == sizeof(void *), "StackheapPtr must be a single word");
 
 #endif
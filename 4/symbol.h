@@ -0,0 +1,175 @@
+#ifndef SYMBOL_H
+#define SYMBOL_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct SymbolEntry
+/*
+  An interned string. Entries are never freed: the characters follow the entry (NUL-terminated).
+ */
+{
+  std::uint64_t hash;
+  std::uint32_t id;    // dense: 1, 2, 3, ... (0 is the empty Symbol)
+  std::uint32_t len;
+
+  mutable std::atomic<std::uint64_t> sample_threshold{~std::uint64_t{0}};   // per-name sampling rate (see sampling.h)
+
+  const char *chars() const { return reinterpret_cast<const char *>(this + 1); }
+};
+
+
+class SymbolTable
+/*
+  Process-wide intern table (open addressing, grows by doubling).
+
+  Lookups of names that were already interned are lock-free (acquire loads while probing);
+  only the first insertion of a name takes the mutex. Replaced tables are kept alive, since
+  concurrent readers may still be probing them.
+ */
+{
+public:
+  static const SymbolEntry *intern(std::string_view s)
+  {
+    if (s.empty())
+      return nullptr;
+    SymbolTable &st = instance();
+    const std::uint64_t h = hash(s);
+    if (const SymbolEntry *e = lookup(st.table.load(std::memory_order_acquire), s, h))
+      return e;
+    return st.insert(s, h);
+  }
+
+  static std::size_t size()
+  {
+    SymbolTable &st = instance();
+    std::lock_guard<std::mutex> lock{st.mtx};
+    return st.n_entries;
+  }
+
+private:
+  struct Table {
+    explicit Table(std::size_t capacity)
+      : mask{capacity - 1}, slots{new std::atomic<const SymbolEntry *>[capacity]}
+    {
+      for (std::size_t i = 0; i < capacity; ++i)
+        slots[i].store(nullptr, std::memory_order_relaxed);
+    }
+
+    std::size_t                                     mask;
+    std::unique_ptr<std::atomic<const SymbolEntry *>[]> slots;
+  };
+
+  SymbolTable()
+  {
+    tables.emplace_back(new Table{256});
+    table.store(tables.back().get(), std::memory_order_release);
+  }
+
+  static SymbolTable &instance()
+  {
+    static SymbolTable *st = new SymbolTable;   // never destroyed: Symbols may outlive static destruction
+    return *st;
+  }
+
+  static std::uint64_t hash(std::string_view s)   // FNV-1a
+  {
+    std::uint64_t h = 0xcbf29ce484222325ULL;
+    for (const char c : s) {
+      h ^= static_cast<unsigned char>(c);
+      h *= 0x100000001b3ULL;
+    }
+    return h;
+  }
+
+  static const SymbolEntry *lookup(const Table *t, std::string_view s, std::uint64_t h)
+  {
+    for (std::size_t i = h & t->mask; ; i = (i + 1) & t->mask) {
+      const SymbolEntry *e = t->slots[i].load(std::memory_order_acquire);
+      if (e == nullptr)
+        return nullptr;
+      if (e->hash == h && e->len == s.size() && std::memcmp(e->chars(), s.data(), s.size()) == 0)
+        return e;
+    }
+  }
+
+  static void put(Table *t, const SymbolEntry *e)
+  {
+    std::size_t i = e->hash & t->mask;
+    while (t->slots[i].load(std::memory_order_relaxed))
+      i = (i + 1) & t->mask;
+    t->slots[i].store(e, std::memory_order_release);
+  }
+
+  const SymbolEntry *insert(std::string_view s, std::uint64_t h)
+  {
+    std::lock_guard<std::mutex> lock{mtx};
+    Table *t = table.load(std::memory_order_relaxed);
+    if (const SymbolEntry *e = lookup(t, s, h))
+      return e;
+
+    if (2 * (n_entries + 1) > t->mask + 1) {   // keep the load factor <= 1/2
+      Table *bigger = new Table{2 * (t->mask + 1)};
+      tables.emplace_back(bigger);
+      for (std::size_t i = 0; i <= t->mask; ++i)
+        if (const SymbolEntry *e = t->slots[i].load(std::memory_order_relaxed))
+          put(bigger, e);
+      table.store(bigger, std::memory_order_release);
+      t = bigger;
+    }
+
+    void *mem = ::operator new(sizeof(SymbolEntry) + s.size() + 1);
+    SymbolEntry *e = new (mem) SymbolEntry{h, static_cast<std::uint32_t>(++n_entries), static_cast<std::uint32_t>(s.size())};
+    char *chars = reinterpret_cast<char *>(e + 1);
+    std::memcpy(chars, s.data(), s.size());
+    chars[s.size()] = '\0';
+    put(t, e);
+    return e;
+  }
+
+  std::atomic<Table *>                table{nullptr};
+  std::mutex                          mtx;         // writers only
+  std::vector<std::unique_ptr<Table>> tables;      // all tables ever published
+  std::size_t                         n_entries = 0;
+};
+
+
+
+class Symbol
+/*
+  Handle to an interned name: a single pointer, trivially copyable.
+  Equal names give the same Symbol, so comparing Symbols compares pointers.
+ */
+{
+public:
+  constexpr Symbol() : entry{nullptr} {}
+  Symbol(std::string_view s)    : entry{SymbolTable::intern(s)} {}
+  Symbol(const std::string &s)  : entry{SymbolTable::intern(s)} {}
+  Symbol(const char *s)         : entry{SymbolTable::intern(s)} {}
+
+  std::string_view view()  const { return entry ? std::string_view{entry->chars(), entry->len} : std::string_view{}; }
+  const char      *c_str() const { return entry ? entry->chars() : ""; }
+  std::string      str()   const { return std::string{view()}; }
+  std::uint32_t    id()    const { return entry ? entry->id : 0U; }
+  bool             empty() const { return entry == nullptr; }
+
+  const SymbolEntry *get_entry() const { return entry; }
+
+  friend bool operator==(Symbol a, Symbol b) { return a.entry == b.entry; }
+  friend bool operator!=(Symbol a, Symbol b) { return a.entry != b.entry; }
+
+  friend std::ostream &operator<<(std::ostream &os, Symbol s) { return os << s.view(); }
+
+private:
+  const SymbolEntry *entry;
+};
+
+#endif
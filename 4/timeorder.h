@@ -0,0 +1,102 @@
+#ifndef TIMEORDER_H
+#define TIMEORDER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <queue>
+#include <vector>
+
+template <typename Record>
+class TimeOrder
+/*
+  Restores the time order of lifecycle records (Event, TraceRecord: anything with a timestamp) taken from
+  the per-thread rings: the drainer delivers them ring after ring, so that the events of a value group shared
+  between threads may arrive out of order (e.g. another thread's copy before the group's constructor).
+
+  Records are held back until a record window [ns] younger has arrived, then released by timestamp
+  (equal timestamps: in arrival order). An operator= record and its assign_result travel as one unit.
+  A record arriving after a younger one was released (its thread stalled for longer than window) is released
+  right away, out of order, and counted as late.
+ */
+{
+public:
+  static constexpr std::uint64_t default_window = 50000000;   // 50 ms
+
+  explicit TimeOrder(std::uint64_t window_ = default_window) : window{window_} {}
+
+  template <typename F>   // F(const Record &): called for the released records
+  void push(const Record &r, bool first_of_pair, F &&f)   // first_of_pair: glue r and the next record together
+  {
+    if (open) {
+      pending.r[1] = r;
+      pending.n    = 2;
+      open         = false;
+      add(pending, f);
+      return;
+    }
+    pending = Unit{{r, r}, 1, seq++};
+    if (first_of_pair)
+      open = true;
+    else
+      add(pending, f);
+  }
+
+  template <typename F>
+  void release_all(F &&f)   // (an unfinished pair stays back)
+  {
+    while (! heap.empty())
+      release(f);
+  }
+
+  std::uint64_t late() const { return n_late; }
+
+private:
+  struct Unit {
+    Record        r[2];
+    std::size_t   n;
+    std::uint64_t seq;
+
+    std::uint64_t timestamp() const { return r[0].timestamp; }
+  };
+
+  struct Later {
+    bool operator()(const Unit &a, const Unit &b) const
+    {
+      return a.timestamp() != b.timestamp() ? a.timestamp() > b.timestamp() : a.seq > b.seq;
+    }
+  };
+
+  template <typename F>
+  void add(const Unit &u, F &&f)
+  {
+    if (u.timestamp() < released)
+      ++n_late;
+    if (u.timestamp() > newest)
+      newest = u.timestamp();
+    heap.push(u);
+    while (! heap.empty() && heap.top().timestamp() + window <= newest)
+      release(f);
+  }
+
+  template <typename F>
+  void release(F &&f)
+  {
+    const Unit u = heap.top();
+    heap.pop();
+    if (u.timestamp() > released)
+      released = u.timestamp();
+    for (std::size_t i = 0; i < u.n; ++i)
+      f(u.r[i]);
+  }
+
+  std::uint64_t                                       window;
+  std::priority_queue<Unit, std::vector<Unit>, Later> heap;
+  Unit                                                pending{};
+  bool                                                open     = false;
+  std::uint64_t                                       seq      = 0;
+  std::uint64_t                                       newest   = 0;
+  std::uint64_t                                       released = 0;
+  std::uint64_t                                       n_late   = 0;
+};
+
+#endif
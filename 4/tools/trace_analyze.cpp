@@ -0,0 +1,260 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../timeorder.h"
+#include "../tracefile.h"
+
+/*
+  trace-analyze <trace file> [n_leaks] [window_ms]
+
+  Rebuilds the lifetimes of the value groups in a binary trace (see tracefile.h) and reports
+  .    leaks          groups still alive at the end of the trace (the n_leaks oldest are listed, default 20)
+  .    peak           maximum of live groups / live instances
+  .    copy fan-out   per group: instances made by copying (copy constructor, operator=)
+  per name.
+
+  The trace is streamed (TraceReader); memory use is bounded by the number of live groups, not by the trace size.
+  Instances are counted the same way as the live-object Registry does (see registry.h).
+
+  The trace holds the records in drain order (one thread's ring after the other): they are put back into time order
+  first (TimeOrder, see timeorder.h; window_ms: how far records may be out of order, default 50).
+  Events of groups never seen created (created before the trace started, or out of order beyond the window)
+  are reported as orphans, not counted.
+ */
+
+struct Group {
+  std::uint32_t name_id;
+  std::uint64_t created;
+  std::uint64_t count;
+  std::uint64_t peak;
+  std::uint64_t copies;
+};
+
+struct NameStats {
+  std::uint64_t groups       = 0;
+  std::uint64_t ended        = 0;
+  std::uint64_t lifetime     = 0;   // sum over ended groups [ns]
+  std::uint64_t lifetime_max = 0;
+  std::uint64_t peak         = 0;   // max instances of one group
+  std::uint64_t copies       = 0;
+  std::uint64_t copies_max   = 0;
+};
+
+class Analysis {
+public:
+  void event(const TraceRecord &r)
+  {
+    if (first == 0)
+      first = r.timestamp;
+    last = r.timestamp > last ? r.timestamp : last;
+    if (r.kind == TraceRecord::dropped) {
+      dropped += r.count;
+      return;
+    }
+    ++n_events;
+    if (skip_next) {   // assign_result after move_assign: rhs's instance is taken over
+      skip_next = false;
+      return;
+    }
+
+    switch (static_cast<EventKind>(r.kind)) {
+    case EventKind::constructor:      create(r);                 break;
+    case EventKind::copy_constructor: update(r, r.batch, true);  break;
+    case EventKind::assign_result:    update(r, 1, true);        break;
+    case EventKind::move_assign:      skip_next = true;          [[fallthrough]];   // (this drops its old value)
+    case EventKind::assign:           release(r, 1);             break;
+    case EventKind::detach:           release(r, 1);             break;
+    case EventKind::destructor:       release(r, r.batch);       break;
+    default:                                                     break;
+    }
+  }
+
+  void report(std::ostream &os, const TraceReader &reader, std::size_t n_leaks, std::uint64_t late) const
+  {
+    os << std::fixed << std::setprecision(6);
+    os << "trace:          " << reader.file_size() << " bytes, " << n_events << " events";
+    if (dropped)
+      os << ", " << dropped << " dropped (results are approximate)";
+    os << ", " << seconds(last - first) << " s\n";
+    if (orphans || late)
+      os << "orphans:        " << orphans << " events of groups not seen created, "
+         << late << " events out of order beyond the window\n";
+    os << "value groups:   " << n_created << " created, " << (n_created - groups.size()) << " ended, "
+       << groups.size() << " leaked (alive at the end of the trace)\n";
+    os << "peak:           " << peak_groups << " live groups (at " << seconds(peak_groups_t - first) << " s), "
+       << peak_instances << " live instances (at " << seconds(peak_instances_t - first) << " s)\n\n";
+
+    // per name, most groups first (peak / copies: of ended and leaked groups)
+    std::unordered_map<std::uint32_t, NameStats>     stats = per_name;
+    std::unordered_map<std::uint32_t, std::uint64_t> leaked;
+    for (const auto &kv : groups) {
+      const Group &g = kv.second;
+      NameStats &s = stats[g.name_id];
+      ++leaked[g.name_id];
+      s.peak        = std::max(s.peak, g.peak);
+      s.copies     += g.copies;
+      s.copies_max  = std::max(s.copies_max, g.copies);
+    }
+    std::vector<std::pair<std::uint32_t, NameStats>> names(stats.begin(), stats.end());
+    std::sort(names.begin(), names.end(), [](const auto &a, const auto &b) { return a.second.groups > b.second.groups; });
+
+    os << std::left << std::setw(24) << "name" << std::right
+       << std::setw(12) << "groups" << std::setw(10) << "leaked" << std::setw(12) << "peak inst"
+       << std::setw(12) << "copies avg" << std::setw(12) << "copies max" << std::setw(16) << "lifetime avg s"
+       << std::setw(16) << "lifetime max s" << '\n';
+    for (const auto &kv : names) {
+      const NameStats &s = kv.second;
+      const auto it = leaked.find(kv.first);
+      os << std::left << std::setw(24) << display_name(reader, kv.first) << std::right
+         << std::setw(12) << s.groups
+         << std::setw(10) << (it == leaked.end() ? 0U : it->second)
+         << std::setw(12) << s.peak
+         << std::setw(12) << std::setprecision(2) << static_cast<double>(s.copies) / static_cast<double>(s.groups)
+         << std::setw(12) << s.copies_max
+         << std::setw(16) << std::setprecision(6) << (s.ended ? seconds(s.lifetime / s.ended) : 0.0)
+         << std::setw(16) << seconds(s.lifetime_max) << '\n';
+    }
+
+    if (groups.empty())
+      return;
+    std::vector<std::pair<std::uint64_t, const Group *>> leaks;
+    for (const auto &kv : groups)
+      leaks.emplace_back(kv.first, &kv.second);
+    std::sort(leaks.begin(), leaks.end(), [](const auto &a, const auto &b) { return a.second->created < b.second->created; });
+    os << "\nleaks (oldest first):\n";
+    for (std::size_t i = 0; i < leaks.size() && i < n_leaks; ++i)
+      os << "  cnt_p 0x" << std::hex << leaks[i].first << std::dec << " \t" << display_name(reader, leaks[i].second->name_id)
+         << " (" << leaks[i].second->count << ") \tcreated at " << seconds(leaks[i].second->created - first) << " s\n";
+    if (leaks.size() > n_leaks)
+      os << "  ... " << (leaks.size() - n_leaks) << " more\n";
+  }
+
+private:
+  static double seconds(std::uint64_t ns) { return static_cast<double>(ns) * 1e-9; }
+
+  static std::string display_name(const TraceReader &reader, std::uint32_t id)
+  {
+    const std::string &n = reader.name(id);
+    return n.empty() ? "(no name)" : n;
+  }
+
+  void create(const TraceRecord &r)
+  {
+    Group &g = groups[r.cnt_p];   // (a group with the same cnt_p, if any, ended without a trace of it)
+    g = Group{r.name_id, r.timestamp, 1U, 1U, 0U};
+    ++n_created;
+    ++per_name[r.name_id].groups;
+    add_instances(r.timestamp, 1);
+    check_peak_groups(r.timestamp);
+  }
+
+  void update(const TraceRecord &r, std::uint64_t n, bool copy)
+  {
+    const auto it = groups.find(r.cnt_p);
+    if (it == groups.end()) {
+      orphan(r);
+      return;
+    }
+    Group &g = it->second;
+    g.count += n;
+    g.peak   = std::max(g.peak, g.count);
+    if (copy)
+      g.copies += n;
+    add_instances(r.timestamp, n);
+  }
+
+  void release(const TraceRecord &r, std::uint64_t n)
+  {
+    const auto it = groups.find(r.cnt_p);
+    if (it == groups.end()) {
+      orphan(r);
+      return;
+    }
+    Group &g = it->second;
+    n = std::min(n, g.count);
+    g.count -= n;
+    live_instances -= n;
+    if (g.count)
+      return;
+
+    NameStats &s = per_name[g.name_id];
+    const std::uint64_t lifetime = r.timestamp - g.created;
+    ++s.ended;
+    s.lifetime     += lifetime;
+    s.lifetime_max  = std::max(s.lifetime_max, lifetime);
+    s.peak          = std::max(s.peak, g.peak);
+    s.copies       += g.copies;
+    s.copies_max    = std::max(s.copies_max, g.copies);
+    groups.erase(it);
+  }
+
+  void orphan(const TraceRecord &r)
+  {
+    if (r.cnt_p != 0)   // (0: moved-from instance, in no group)
+      ++orphans;
+  }
+
+  void add_instances(std::uint64_t t, std::uint64_t n)
+  {
+    live_instances += n;
+    if (live_instances > peak_instances) {
+      peak_instances   = live_instances;
+      peak_instances_t = t;
+    }
+  }
+
+  void check_peak_groups(std::uint64_t t)
+  {
+    if (groups.size() > peak_groups) {
+      peak_groups   = groups.size();
+      peak_groups_t = t;
+    }
+  }
+
+  std::unordered_map<std::uint64_t, Group>     groups;     // live groups, by cnt_p
+  std::unordered_map<std::uint32_t, NameStats> per_name;
+
+  std::uint64_t first = 0, last = 0;
+  std::uint64_t n_events = 0, dropped = 0, n_created = 0, orphans = 0;
+  std::uint64_t live_instances = 0;
+  std::uint64_t peak_groups = 0, peak_groups_t = 0;
+  std::uint64_t peak_instances = 0, peak_instances_t = 0;
+  bool          skip_next = false;
+};
+
+
+int main(int argc, char *argv[])
+{
+  if (argc < 2) {
+    std::cerr << "usage: " << argv[0] << " <trace file> [n_leaks] [window_ms]" << std::endl;
+    return 2;
+  }
+  const std::size_t   n_leaks = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 20U;
+  const std::uint64_t window  = argc > 3 ? std::strtoull(argv[3], nullptr, 10) * 1000000U
+                                         : TimeOrder<TraceRecord>::default_window;
+
+  try {
+    TraceReader reader{argv[1]};
+    Analysis a;
+    TimeOrder<TraceRecord> order{window};
+    const auto analyze = [&a](const TraceRecord &r) { a.event(r); };
+    reader.for_each([&](const TraceRecord &r) {
+        const bool assign = r.kind == static_cast<std::uint8_t>(EventKind::assign)
+                         || r.kind == static_cast<std::uint8_t>(EventKind::move_assign);
+        order.push(r, assign, analyze);
+      });
+    order.release_all(analyze);
+    a.report(std::cout, reader, n_leaks, order.late());
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
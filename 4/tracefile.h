@@ -0,0 +1,294 @@
+#ifndef TRACEFILE_H
+#define TRACEFILE_H
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "eventlog.h"
+
+/*
+  Binary trace file: append-only sequence of fixed-width records of 48 bytes (host byte order).
+
+  TraceHeader     first record: magic "BWTRACE1", record size
+  TraceRecord     one lifecycle event (kind: EventKind), the name by id
+  .               kind name_def: defines name id (count: length), followed by ceil(length / 48) records of characters;
+  .                              written once, before the first event that refers to the name
+  .               kind dropped:  count events were dropped (ring buffer full)
+  A record with timestamp 0 ends the trace (the unused rest of the last window, if the writer did not finish).
+
+  TraceSink writes (EventSink, on the drainer thread), TraceReader streams (see tools/trace_analyze.cpp).
+  Both map the file window by window, so neither holds more than one window of a trace in memory.
+ */
+
+struct TraceHeader {
+  char          magic[8];
+  std::uint32_t version;
+  std::uint32_t record_size;
+  std::uint8_t  reserved[32];
+
+  static constexpr char          magic_v[8] = {'B', 'W', 'T', 'R', 'A', 'C', 'E', '1'};
+  static constexpr std::uint32_t version_v  = 1;
+};
+
+struct TraceRecord {
+  std::uint64_t timestamp;   // steady_clock [ns]
+  std::uint64_t obj;
+  std::uint64_t cnt_p;
+  std::uint64_t count;
+  std::uint64_t batch;
+  std::uint32_t name_id;     // Symbol::id(), 0: no name
+  std::uint8_t  kind;        // EventKind, or name_def / dropped
+  std::uint8_t  reserved[3];
+
+  static constexpr std::uint8_t name_def = 0xF0;
+  static constexpr std::uint8_t dropped  = 0xF1;
+};
+
+static_assert(sizeof(TraceHeader) == 48 && sizeof(TraceRecord) == 48, "trace records are 48 bytes");
+
+// window size: a multiple of both the page size (mmap offsets) and the record size (no record straddles a window)
+inline std::size_t trace_window_size(std::size_t pages_per_record_group)
+{
+  return sizeof(TraceRecord) * static_cast<std::size_t>(::sysconf(_SC_PAGESIZE)) * pages_per_record_group;
+}
+
+
+
+class TraceSink : public EventSink
+/*
+  Writes events to a binary trace file (see above): records are copied into a shared mapping of the file,
+  which grows window by window (ftruncate). The file is truncated to its final size on destruction.
+ */
+{
+public:
+  explicit TraceSink(const std::string &path)
+    : window{trace_window_size(256)}
+  {
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+      throw std::system_error{errno, std::generic_category(), "TraceSink: open " + path};
+    try {
+      next_window();
+    } catch (...) {
+      ::close(fd);
+      throw;
+    }
+
+    TraceHeader h{};
+    std::memcpy(h.magic, TraceHeader::magic_v, sizeof(h.magic));
+    h.version     = TraceHeader::version_v;
+    h.record_size = sizeof(TraceRecord);
+    std::memcpy(cur, &h, sizeof(h));
+    cur += sizeof(h);
+  }
+
+  TraceSink(const TraceSink &) = delete;
+  TraceSink &operator=(const TraceSink &) = delete;
+
+  ~TraceSink() override
+  {
+    const off_t size = offset + (cur - map);
+    ::munmap(map, window);
+    ::ftruncate(fd, size);
+    ::close(fd);
+  }
+
+  void consume(const Event *ev, std::size_t n) override
+  {
+    for (std::size_t i = 0; i < n; ++i) {
+      const Event &e = ev[i];
+      const std::uint32_t id = e.name.id();
+      if (id >= defined.size())
+        defined.resize(id + 1, false);
+      if (id && ! defined[id]) {
+        put_name(id, e.name.view(), e.timestamp);
+        defined[id] = true;
+      }
+
+      TraceRecord r{};
+      r.timestamp = e.timestamp;
+      r.obj       = reinterpret_cast<std::uintptr_t>(e.obj);
+      r.cnt_p     = reinterpret_cast<std::uintptr_t>(e.cnt_p);
+      r.count     = e.count;
+      r.batch     = e.batch;
+      r.name_id   = id;
+      r.kind      = static_cast<std::uint8_t>(e.kind);
+      put(&r, sizeof(r));
+    }
+  }
+
+  void dropped(std::size_t n) override
+  {
+    TraceRecord r{};
+    r.timestamp = Event::now();
+    r.count     = n;
+    r.kind      = TraceRecord::dropped;
+    put(&r, sizeof(r));
+  }
+
+  void flush() override
+  {
+    ::msync(map, static_cast<std::size_t>(cur - map), MS_ASYNC);
+  }
+
+private:
+  void put(const void *p, std::size_t size)   // size: a multiple of sizeof(TraceRecord)
+  {
+    const char *src = static_cast<const char *>(p);
+    while (size) {
+      if (cur == map + window)
+        next_window();
+      std::memcpy(cur, src, sizeof(TraceRecord));
+      cur  += sizeof(TraceRecord);
+      src  += sizeof(TraceRecord);
+      size -= sizeof(TraceRecord);
+    }
+  }
+
+  void put_name(std::uint32_t id, std::string_view s, std::uint64_t timestamp)
+  {
+    TraceRecord r{};
+    r.timestamp = timestamp;
+    r.count     = s.size();
+    r.name_id   = id;
+    r.kind      = TraceRecord::name_def;
+    put(&r, sizeof(r));
+
+    for (std::size_t pos = 0; pos < s.size(); pos += sizeof(TraceRecord)) {
+      char chars[sizeof(TraceRecord)] = {};
+      s.copy(chars, sizeof(chars), pos);
+      put(chars, sizeof(chars));
+    }
+  }
+
+  void next_window()
+  {
+    if (map) {
+      ::munmap(map, window);
+      offset += static_cast<off_t>(window);
+    }
+    if (::ftruncate(fd, offset + static_cast<off_t>(window)) != 0)
+      throw std::system_error{errno, std::generic_category(), "TraceSink: ftruncate"};
+    void *m = ::mmap(nullptr, window, PROT_READ | PROT_WRITE, MAP_SHARED, fd, offset);
+    if (m == MAP_FAILED)
+      throw std::system_error{errno, std::generic_category(), "TraceSink: mmap"};
+    map = cur = static_cast<char *>(m);
+  }
+
+  std::size_t       window;
+  int               fd     = -1;
+  off_t             offset = 0;         // file offset of the current window
+  char             *map    = nullptr;
+  char             *cur    = nullptr;
+  std::vector<bool> defined;            // name ids already written
+};
+
+
+
+class TraceReader
+/*
+  Streams a binary trace file: maps one read-only window at a time (sequential access), so that
+  traces much bigger than memory can be processed. Name definitions are collected into names().
+ */
+{
+public:
+  explicit TraceReader(const std::string &path)
+    : window{trace_window_size(1024)}
+  {
+    fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      throw std::system_error{errno, std::generic_category(), "TraceReader: open " + path};
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+      ::close(fd);
+      throw std::system_error{errno, std::generic_category(), "TraceReader: stat " + path};
+    }
+    size = static_cast<std::uint64_t>(st.st_size);
+
+    TraceHeader h{};
+    if (size < sizeof(h) || ::pread(fd, &h, sizeof(h), 0) != static_cast<ssize_t>(sizeof(h))
+        || std::memcmp(h.magic, TraceHeader::magic_v, sizeof(h.magic)) != 0
+        || h.version != TraceHeader::version_v || h.record_size != sizeof(TraceRecord)) {
+      ::close(fd);
+      throw std::runtime_error{"TraceReader: " + path + " is not a trace file (version 1)"};
+    }
+  }
+
+  TraceReader(const TraceReader &) = delete;
+  TraceReader &operator=(const TraceReader &) = delete;
+
+  ~TraceReader()
+  {
+    ::close(fd);
+  }
+
+  std::uint64_t file_size() const { return size; }
+
+  const std::vector<std::string> &names() const { return name_table; }
+  const std::string &name(std::uint32_t id) const
+  {
+    static const std::string none;
+    return id < name_table.size() ? name_table[id] : none;
+  }
+
+  template <typename F>   // F(const TraceRecord &r) -- for events (r.kind: EventKind) and r.kind == TraceRecord::dropped
+  void for_each(F &&f)
+  {
+    std::size_t  name_left = 0;   // characters of a name_def still to come
+    std::string *name_dst  = nullptr;
+
+    for (std::uint64_t off = 0; off < size; off += window) {
+      const std::size_t len = static_cast<std::size_t>(size - off < window ? size - off : window);
+      void *m = ::mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, static_cast<off_t>(off));
+      if (m == MAP_FAILED)
+        throw std::system_error{errno, std::generic_category(), "TraceReader: mmap"};
+      ::madvise(m, len, MADV_SEQUENTIAL);
+
+      const char *p   = static_cast<const char *>(m) + (off == 0 ? sizeof(TraceHeader) : 0);
+      const char *end = static_cast<const char *>(m) + len / sizeof(TraceRecord) * sizeof(TraceRecord);
+      for (; p != end; p += sizeof(TraceRecord)) {
+        if (name_left) {
+          const std::size_t k = name_left < sizeof(TraceRecord) ? name_left : sizeof(TraceRecord);
+          name_dst->append(p, k);
+          name_left -= k;
+          continue;
+        }
+        TraceRecord r;
+        std::memcpy(&r, p, sizeof(r));
+        if (r.timestamp == 0) {   // unfinished file
+          ::munmap(m, len);
+          return;
+        }
+        if (r.kind == TraceRecord::name_def) {
+          if (r.name_id >= name_table.size())
+            name_table.resize(r.name_id + 1);
+          name_dst = &name_table[r.name_id];
+          name_dst->clear();
+          name_left = static_cast<std::size_t>(r.count);
+          continue;
+        }
+        f(r);
+      }
+      ::munmap(m, len);
+    }
+  }
+
+private:
+  std::size_t              window;
+  int                      fd   = -1;
+  std::uint64_t            size = 0;
+  std::vector<std::string> name_table;
+};
+
+#endif
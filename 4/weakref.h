@@ -0,0 +1,89 @@
+#ifndef WEAKREF_H
+#define WEAKREF_H
+
+#include <cstddef>
+#include <utility>
+
+#include "refcount.h"
+
+template <typename T, typename CntPolicy = CntWeak<>, typename Alloc = PoolAlloc>
+class WeakRef {
+  /*
+    Weak reference to a value group of RefCount<T, CntPolicy, Alloc> (CntPolicy: CntWeak, see cntpolicy.h):
+    observes the group without keeping the value alive (e.g. caches), but keeps its counter alive.
+
+    expired() / use_count() only read the counter, never the value.
+    lock() makes a new instance of the group, if the group is still alive (else a null instance: use_count() == 0).
+
+    Memory from the outside (counter or data passed to RefCount): as for the instances, the caller keeps it
+    alive -- here, until the last WeakRef is gone as well. Arena memory: WeakRefs must not outlive the Arena.
+   */
+  static_assert(CntPolicy::weak, "WeakRef needs a counter with a weak count (CntWeak)");
+
+  using ref_t      = RefCount<T, CntPolicy, Alloc>;
+  using cnt_t      = typename ref_t::cnt_t;
+  using data_ptr_t = typename ref_t::data_ptr_t;
+public:
+  WeakRef() noexcept
+    : cnt_p{StackheapPtr<cnt_t, Alloc>::null()}, data{data_ptr_t::null()}
+  {
+  }
+
+  WeakRef(const ref_t &r) noexcept
+    : cnt_p{r.cnt_p}, data{r.data}
+  {
+    if (cnt_p)
+      CntPolicy::weak_inc(*cnt_p);
+  }
+
+  WeakRef(const WeakRef &rhs) noexcept
+    : cnt_p{rhs.cnt_p}, data{rhs.data}
+  {
+    if (cnt_p)
+      CntPolicy::weak_inc(*cnt_p);
+  }
+
+  WeakRef(WeakRef &&rhs) noexcept   // rhs is left null
+    : cnt_p{std::move(rhs.cnt_p)}, data{std::move(rhs.data)}
+  {
+  }
+
+  WeakRef &operator=(const WeakRef &rhs)
+  {
+    WeakRef tmp{rhs};
+    swap(tmp);
+    return *this;
+  }
+
+  WeakRef &operator=(WeakRef &&rhs) noexcept   // rhs is left null
+  {
+    WeakRef tmp{std::move(rhs)};
+    swap(tmp);
+    return *this;
+  }
+
+  ~WeakRef()
+  {
+    if (cnt_p)
+      ref_t::weak_release(cnt_p, data);
+  }
+
+  bool        expired()   const { return use_count() == 0; }
+  std::size_t use_count() const { return cnt_p ? CntPolicy::load(*cnt_p) : 0U; }
+
+  ref_t lock() const { return ref_t{cnt_p, data}; }
+
+  const cnt_t *get_shared_cnt_ptr() const { return cnt_p.get(); }
+
+  void swap(WeakRef &rhs) noexcept
+  {
+    std::swap(cnt_p, rhs.cnt_p);
+    std::swap(data,  rhs.data);
+  }
+
+private:
+  StackheapPtr<cnt_t, Alloc> cnt_p;
+  data_ptr_t                 data;
+};
+
+#endif